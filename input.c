@@ -0,0 +1,340 @@
+#include <avr/interrupt.h>
+#include "input.h"
+
+#if defined(ENABLE_INPUT)
+
+extern volatile int scanLine;
+extern int stop_render;
+extern uint8_t start_render;
+
+/* US layout, indexed by set 2 scan code */
+static const char ps2_ascii[] PROGMEM =
+{
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, '\t', '`', 0,
+	0, 0, 0, 0, 0, 'q', '1', 0,
+	0, 0, 'z', 's', 'a', 'w', '2', 0,
+	0, 'c', 'x', 'd', 'e', '4', '3', 0,
+	0, ' ', 'v', 'f', 't', 'r', '5', 0,
+	0, 'n', 'b', 'h', 'g', 'y', '6', 0,
+	0, 0, 'm', 'j', 'u', '7', '8', 0,
+	0, ',', 'k', 'i', 'o', '0', '9', 0,
+	0, '.', '/', 'l', ';', 'p', '-', 0,
+	0, 0, '\'', 0, '[', '=', 0, 0,
+	0, 0, '\r', ']', 0, '\\', 0, 0,
+	0, 0, 0, 0, 0, 0, '\b', 0,
+	0, '1', 0, '4', '7', 0, 0, 0,
+	'0', '.', '2', '5', '6', '8', 0x1B, 0,
+	0, '+', '3', '-', '*', '9', 0, 0
+};
+
+static const char ps2_shift[] PROGMEM =
+{
+	0, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, '\t', '~', 0,
+	0, 0, 0, 0, 0, 'Q', '!', 0,
+	0, 0, 'Z', 'S', 'A', 'W', '@', 0,
+	0, 'C', 'X', 'D', 'E', '$', '#', 0,
+	0, ' ', 'V', 'F', 'T', 'R', '%', 0,
+	0, 'N', 'B', 'H', 'G', 'Y', '^', 0,
+	0, 0, 'M', 'J', 'U', '&', '*', 0,
+	0, '<', 'K', 'I', 'O', ')', '(', 0,
+	0, '>', '?', 'L', ':', 'P', '_', 0,
+	0, 0, '"', 0, '{', '+', 0, 0,
+	0, 0, '\r', '}', 0, '|', 0, 0,
+	0, 0, 0, 0, 0, 0, '\b', 0,
+	0, '1', 0, '4', '7', 0, 0, 0,
+	'0', '.', '2', '5', '6', '8', 0x1B, 0,
+	0, '+', '3', '-', '*', '9', 0, 0
+};
+
+/* event queue, the line interrupt only writes in_head */
+static uint16_t in_queue[INPUT_QUEUE];
+static volatile uint8_t in_head, in_tail;
+
+/* keyboard frame and scan code state */
+static volatile uint8_t ps2_n;
+static uint8_t ps2_inhibit, ps2_byte, ps2_par;
+static uint8_t ps2_ext, ps2_brk, ps2_skip, ps2_shifts;
+
+/* pad shift in progress, one step per blanking line */
+static uint16_t pad_state[2], pad_shift[2];
+static uint8_t pad_step;
+
+static void input_push(uint8_t type, uint8_t code)
+{
+	uint8_t h = (in_head + 1) & (INPUT_QUEUE - 1);
+	if(h != in_tail)
+	{
+		in_queue[in_head] = ((uint16_t)type << 8) | code;
+		in_head = h;
+	}
+}
+
+static void ps2_code(uint8_t b)
+{
+	uint8_t code;
+	if(ps2_skip)
+	{
+		--ps2_skip;
+		return;
+	}
+
+	switch(b)
+	{
+		case 0xE0:
+		{
+			ps2_ext = 1;
+			return;
+		}
+
+		case 0xF0:
+		{
+			ps2_brk = 1;
+			return;
+		}
+
+		case 0xE1:
+		{
+			/* pause sends E1 14 77 E1 F0 14 F0 77 without a break */
+			ps2_skip = 7;
+			return;
+		}
+	}
+
+	/* F7 is the only key code above 0x7F */
+	if(b == 0x83)
+	{
+		b = KEY_F7;
+	}
+
+	/* acks, self test and error codes */
+	if(b & 0x80)
+	{
+		ps2_ext = ps2_brk = 0;
+		return;
+	}
+
+	code = ps2_ext ? (KEY_EXT | b) : b;
+	if(code == 0x12 || code == 0x59)
+	{
+		ps2_shifts = ps2_brk ? (ps2_shifts & ~(code & 1 ? 2 : 1)) :
+			(ps2_shifts | (code & 1 ? 2 : 1));
+	}
+
+	input_push(ps2_brk ? EV_KEY_UP : EV_KEY_DOWN, code);
+	ps2_ext = ps2_brk = 0;
+}
+
+/* start bit, 8 data bits LSB first, odd parity, stop bit */
+static void ps2_bit(uint8_t d)
+{
+	if(!ps2_n)
+	{
+		if(d)
+		{
+			return;
+		}
+
+		ps2_byte = 0;
+		ps2_par = 0;
+	}
+	else if(ps2_n <= 8)
+	{
+		ps2_byte >>= 1;
+		if(d)
+		{
+			ps2_byte |= 0x80;
+			ps2_par ^= 1;
+		}
+	}
+	else if(ps2_n == 9)
+	{
+		if(d)
+		{
+			ps2_par ^= 1;
+		}
+	}
+	else
+	{
+		if(d && ps2_par)
+		{
+			ps2_code(ps2_byte);
+		}
+
+		ps2_n = 0;
+		return;
+	}
+
+	++ps2_n;
+}
+
+/* the keyboard changes data while the clock is high, a bit is taken
+   on every falling edge */
+ISR(PS2_vect)
+{
+	if(!(PS2_IN & (1 << PS2_CLK)))
+	{
+		ps2_bit(PS2_IN & (1 << PS2_DATA));
+	}
+}
+
+/* latch, then per bit the clock low with the bit read and the clock
+   high again to shift the next one out */
+static void pad_next(void)
+{
+	uint8_t i, p;
+	uint16_t m;
+	if(pad_step == 1)
+	{
+		PAD_PORT |= (1 << PAD_LATCH);
+		pad_shift[0] = 0;
+		pad_shift[1] = 0;
+		++pad_step;
+		return;
+	}
+
+	if(pad_step & 1)
+	{
+		PAD_PORT |= (1 << PAD_CLOCK);
+		++pad_step;
+		return;
+	}
+
+	PAD_PORT &= ~((1 << PAD_LATCH) | (1 << PAD_CLOCK));
+	p = PAD_IN;
+	m = (uint16_t)1 << ((pad_step >> 1) - 1);
+	if(!(p & (1 << PAD_DATA0)))
+	{
+		pad_shift[0] |= m;
+	}
+
+	if(!(p & (1 << PAD_DATA1)))
+	{
+		pad_shift[1] |= m;
+	}
+
+	if(pad_step < 2 * PAD_BITS)
+	{
+		++pad_step;
+		return;
+	}
+
+	for(i = 0, m = 1; i < PAD_BITS; ++i, m <<= 1)
+	{
+		if((pad_shift[0] ^ pad_state[0]) & m)
+		{
+			input_push((pad_shift[0] & m) ? EV_PAD_DOWN : EV_PAD_UP, i);
+		}
+
+		if((pad_shift[1] ^ pad_state[1]) & m)
+		{
+			input_push((pad_shift[1] & m) ? EV_PAD_DOWN : EV_PAD_UP, 16 + i);
+		}
+	}
+
+	pad_state[0] = pad_shift[0];
+	pad_state[1] = pad_shift[1];
+	pad_step = 0;
+}
+
+void input_begin(void)
+{
+	/* released: inputs with pull-up */
+	PS2_DDR &= ~((1 << PS2_CLK) | (1 << PS2_DATA));
+	PS2_PORT |= (1 << PS2_CLK) | (1 << PS2_DATA);
+	PS2_PCMSK |= (1 << PS2_CLK);
+	PCICR |= (1 << PS2_PCIE);
+
+	PAD_DDR |= (1 << PAD_LATCH) | (1 << PAD_CLOCK);
+	PAD_PORT &= ~((1 << PAD_LATCH) | (1 << PAD_CLOCK));
+	PAD_DDR &= ~((1 << PAD_DATA0) | (1 << PAD_DATA1));
+	PAD_PORT |= (1 << PAD_DATA0) | (1 << PAD_DATA1);
+}
+
+/* next event or 0 */
+uint16_t input_get(void)
+{
+	uint16_t e;
+	if(in_tail == in_head)
+	{
+		return 0;
+	}
+
+	e = in_queue[in_tail];
+	in_tail = (in_tail + 1) & (INPUT_QUEUE - 1);
+	return e;
+}
+
+/* character for a key code with the current shift state, 0 if none */
+char input_ascii(uint8_t code)
+{
+	if(code == (KEY_EXT | 0x4A))
+	{
+		return '/';
+	}
+
+	if(code == (KEY_EXT | 0x5A))
+	{
+		return '\r';
+	}
+
+	if(code & KEY_EXT)
+	{
+		return 0;
+	}
+
+	return pgm_read_byte((ps2_shifts ? ps2_shift : ps2_ascii) + code);
+}
+
+/* buttons held, bit n is button n */
+uint16_t input_pad(uint8_t n)
+{
+	uint16_t s;
+	cli();
+	s = pad_state[n & 1];
+	sei();
+	return s;
+}
+
+/* called from blank_line and vsync_line. The keyboard clock is held
+   low during the active area, the keyboard aborts and later resends a
+   byte it could not finish. A pad read starts after release and takes
+   2 * PAD_BITS blanking lines. */
+void input_line(void)
+{
+	int line = scanLine;
+	if(line >= start_render - INPUT_GUARD && line <= stop_render)
+	{
+		if(!ps2_inhibit)
+		{
+			PS2_PCMSK &= ~(1 << PS2_CLK);
+			PS2_PORT &= ~(1 << PS2_CLK);
+			PS2_DDR |= (1 << PS2_CLK);
+			ps2_inhibit = 1;
+			ps2_n = 0;
+		}
+
+		return;
+	}
+
+	if(ps2_inhibit)
+	{
+		PS2_DDR &= ~(1 << PS2_CLK);
+		PS2_PORT |= (1 << PS2_CLK);
+		PCIFR = (1 << PS2_PCIF);
+		PS2_PCMSK |= (1 << PS2_CLK);
+		ps2_inhibit = 0;
+		if(!pad_step)
+		{
+			pad_step = 1;
+		}
+	}
+
+	if(pad_step)
+	{
+		pad_next();
+	}
+}
+
+#endif /* ENABLE_INPUT */
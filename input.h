@@ -0,0 +1,45 @@
+#ifndef __INPUT_H__
+#define __INPUT_H__
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "video_conf.h"
+
+/* event types, an event is (type << 8) | code */
+#define EV_KEY_DOWN 1
+#define EV_KEY_UP   2
+#define EV_PAD_DOWN 3
+#define EV_PAD_UP   4
+
+#define INPUT_TYPE(e) ((uint8_t)((e) >> 8))
+#define INPUT_CODE(e) ((uint8_t)(e))
+
+/* key codes are PS/2 set 2 scan codes, E0 extended keys have bit 7 set */
+#define KEY_EXT    0x80
+
+/* F7 is 0x83 in set 2, reported as this unused code */
+#define KEY_F7     0x02
+
+/* pad codes are pad * 16 + button, SNES order */
+#define BTN_B       0
+#define BTN_Y       1
+#define BTN_SELECT  2
+#define BTN_START   3
+#define BTN_UP      4
+#define BTN_DOWN    5
+#define BTN_LEFT    6
+#define BTN_RIGHT   7
+#define BTN_A       8
+#define BTN_X       9
+#define BTN_L      10
+#define BTN_R      11
+
+void input_begin(void);
+uint16_t input_get(void);
+char input_ascii(uint8_t code);
+uint16_t input_pad(uint8_t n);
+
+void input_line(void);
+
+#endif /* __INPUT_H__ */
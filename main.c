@@ -4,10 +4,16 @@
 int main(void)
 {
 	video_begin(NTSC);
+#if defined(ENABLE_DISPLAY_LIST)
+	video_dl_rect(20, 20, 40, 40);
+	video_dl_line(0, 95, 127, 0);
+	video_dl_string(10, 70, "Hello!");
+#else
 	video_clear();
 	video_rect(20, 20, 40, 40);
 	video_line(0, 95, 127, 0);
 	video_string(10, 70, "Hello!");
+#endif
 
 	for(;;)
 	{
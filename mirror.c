@@ -0,0 +1,319 @@
+#include <avr/interrupt.h>
+#include "mirror.h"
+
+#if defined(ENABLE_MIRROR)
+
+#define MIRROR_UBRR ((F_CPU / 8 + MIRROR_BAUD / 2) / MIRROR_BAUD - 1)
+
+/* encoder states */
+#define MS_OFF    0
+#define MS_WAIT   1
+#define MS_SCAN   2
+#define MS_TOKEN  3
+#define MS_LIT    4
+#define MS_SUM    5
+#define MS_MARK   6
+
+extern uint8_t frame[];
+extern volatile int scanLine;
+extern int stop_render;
+extern uint8_t start_render;
+
+/* output ring, the encoder only writes ms_head and the line interrupt
+   that drains it only writes ms_tail */
+static uint8_t ms_buf[MIRROR_BUF];
+static volatile uint8_t ms_head, ms_tail;
+
+#if defined(ENABLE_DIRTY)
+/* rows changed since they were last sent, marked with the dirty rows
+   of the framebuffer by video_dirty_mark */
+uint8_t mirror_dirty[(HEIGHT + 7) / 8];
+#else
+/* checksum of every row as it was last sent */
+static uint16_t ms_sum[HEIGHT];
+#endif
+
+static volatile uint8_t ms_state, ms_busy;
+static uint8_t ms_row, ms_pos, ms_left, ms_s1, ms_s2, ms_force;
+static int ms_last;
+
+static uint8_t ms_window(void)
+{
+	int line = scanLine;
+	return line < start_render - MIRROR_GUARD || line > stop_render;
+}
+
+static uint8_t ms_free(void)
+{
+	return (ms_tail - ms_head - 1) & (MIRROR_BUF - 1);
+}
+
+static void ms_put(uint8_t b)
+{
+	ms_buf[ms_head] = b;
+	ms_head = (ms_head + 1) & (MIRROR_BUF - 1);
+}
+
+/* k bytes b of the row, for the checksum */
+static void ms_sum_add(uint8_t b, uint8_t k)
+{
+	while(k--)
+	{
+		ms_s1 += b;
+		ms_s2 += ms_s1;
+	}
+}
+
+#if defined(ENABLE_DIRTY)
+/* whether row y changed since it was last sent, the mark is cleared
+   before the row is read so a change while it is sent marks it again */
+static uint8_t ms_changed(uint8_t y)
+{
+	uint8_t m = 0x80 >> (y & 7), sreg = SREG, c;
+	cli();
+	c = mirror_dirty[y >> 3] & m;
+	mirror_dirty[y >> 3] &= ~m;
+	SREG = sreg;
+	return c;
+}
+#else
+/* same as the decoder */
+static uint16_t ms_row_sum(const uint8_t *p)
+{
+	uint8_t i, s1 = 0, s2 = 0;
+	for(i = 0; i < WIDTH; ++i)
+	{
+		s1 += p[i];
+		s2 += s1;
+	}
+
+	return ((uint16_t)s2 << 8) | s1;
+}
+
+static uint8_t ms_changed(uint8_t y)
+{
+	return ms_row_sum(frame + y * WIDTH) != ms_sum[y];
+}
+#endif
+
+/* one PackBits control byte at ms_pos: a run of 3 or more equal bytes
+   becomes 257 - n and the byte, anything else literals up to the next
+   such run */
+static void ms_token(void)
+{
+	const uint8_t *p = frame + ms_row * WIDTH + ms_pos;
+	uint8_t n = WIDTH - ms_pos, k;
+	if(n > 128)
+	{
+		n = 128;
+	}
+
+	for(k = 1; k < n && p[k] == p[0]; ++k)
+	{
+	}
+
+	if(k >= 3 || k == n)
+	{
+		ms_put(257 - k);
+		ms_put(p[0]);
+		ms_sum_add(p[0], k);
+		ms_pos += k;
+		return;
+	}
+
+	for(k = 1; k + 2 < n; ++k)
+	{
+		if(p[k] == p[k + 1] && p[k] == p[k + 2])
+		{
+			break;
+		}
+	}
+
+	if(k + 2 >= n)
+	{
+		k = n;
+	}
+
+	ms_put(k - 1);
+	ms_left = k;
+	ms_state = MS_LIT;
+}
+
+/* a changed row goes out as MIRROR_ROW, its index, PackBits for WIDTH
+   bytes and the two bytes s1, s2 of the Fletcher sum of the bytes that
+   were sent. Every pass over the rows starts with MIRROR_FRAME, WIDTH,
+   HEIGHT and BPP. */
+static void ms_step(void)
+{
+	uint8_t b;
+	switch(ms_state)
+	{
+		case MS_SCAN:
+		{
+			if(ms_row >= HEIGHT)
+			{
+				if(++ms_force >= HEIGHT)
+				{
+					ms_force = 0;
+				}
+
+				ms_state = MS_WAIT;
+			}
+			/* one row per pass is sent anyway, so a decoder that
+			   started late or lost a row catches up */
+			else if(!ms_changed(ms_row) && ms_row != ms_force)
+			{
+				++ms_row;
+			}
+			else
+			{
+				ms_put(MIRROR_ROW);
+				ms_put(ms_row);
+				ms_pos = 0;
+				ms_s1 = 0;
+				ms_s2 = 0;
+				ms_state = MS_TOKEN;
+			}
+
+			break;
+		}
+
+		case MS_TOKEN:
+		{
+			if(ms_pos >= WIDTH)
+			{
+				ms_state = MS_SUM;
+			}
+			else
+			{
+				ms_token();
+			}
+
+			break;
+		}
+
+		case MS_LIT:
+		{
+			b = frame[ms_row * WIDTH + ms_pos];
+			ms_put(b);
+			ms_sum_add(b, 1);
+			++ms_pos;
+			if(!--ms_left)
+			{
+				ms_state = MS_TOKEN;
+			}
+
+			break;
+		}
+
+		case MS_MARK:
+		{
+			ms_put(MIRROR_FRAME);
+			ms_put(WIDTH);
+			ms_put(HEIGHT);
+			ms_put(BPP);
+			ms_row = 0;
+			ms_state = MS_SCAN;
+			break;
+		}
+
+		case MS_SUM:
+		{
+#if !defined(ENABLE_DIRTY)
+			ms_sum[ms_row] = ((uint16_t)ms_s2 << 8) | ms_s1;
+#endif
+			ms_put(ms_s1);
+			ms_put(ms_s2);
+			++ms_row;
+			ms_state = MS_SCAN;
+			break;
+		}
+	}
+}
+
+void mirror_begin(void)
+{
+	UBRR0 = MIRROR_UBRR;
+	UCSR0A = (1 << U2X0);
+	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+	UCSR0B = (1 << TXEN0);
+
+	mirror_refresh();
+	cli();
+	ms_head = ms_tail = 0;
+	ms_state = MS_MARK;
+	sei();
+}
+
+void mirror_stop(void)
+{
+	cli();
+	ms_state = MS_OFF;
+	sei();
+	UCSR0B = 0;
+}
+
+/* sends every row again in the next pass */
+void mirror_refresh(void)
+{
+	uint8_t i;
+#if defined(ENABLE_DIRTY)
+	for(i = 0; i < sizeof(mirror_dirty); ++i)
+	{
+		mirror_dirty[i] = 0xFF;
+	}
+#else
+	for(i = 0; i < HEIGHT; ++i)
+	{
+		ms_sum[i] = ~ms_row_sum(frame + i * WIDTH);
+	}
+#endif
+}
+
+/* runs at the end of every line interrupt. Sends a byte when the USART
+   is ready, which keeps the link busy at up to one byte per line, and
+   outside the active area encodes up to MIRROR_CHUNK steps with
+   interrupts enabled. A pass over the rows starts at most once a frame. */
+void mirror_line(void)
+{
+	int line = scanLine;
+	uint8_t n;
+	if(ms_state == MS_OFF)
+	{
+		return;
+	}
+
+	if(ms_tail != ms_head && (UCSR0A & (1 << UDRE0)))
+	{
+		UDR0 = ms_buf[ms_tail];
+		ms_tail = (ms_tail + 1) & (MIRROR_BUF - 1);
+	}
+
+	if(line < ms_last && ms_state == MS_WAIT)
+	{
+		ms_state = MS_MARK;
+	}
+
+	ms_last = line;
+	if(ms_busy || ms_state == MS_WAIT || !ms_window())
+	{
+		return;
+	}
+
+	ms_busy = 1;
+	sei();
+	for(n = MIRROR_CHUNK; n && ms_free() >= 4 && ms_window(); --n)
+	{
+		if(ms_state == MS_OFF || ms_state == MS_WAIT)
+		{
+			break;
+		}
+
+		ms_step();
+	}
+
+	cli();
+	ms_busy = 0;
+}
+
+#endif /* ENABLE_MIRROR */
@@ -0,0 +1,22 @@
+#ifndef __MIRROR_H__
+#define __MIRROR_H__
+
+#include <stdint.h>
+#include <avr/io.h>
+#include "video_conf.h"
+
+/* stream format, see tools/mirror.c */
+#define MIRROR_ROW    0xA5
+#define MIRROR_FRAME  0x5A
+
+void mirror_begin(void);
+void mirror_stop(void);
+void mirror_refresh(void);
+
+void mirror_line(void);
+
+#if defined(ENABLE_DIRTY)
+extern uint8_t mirror_dirty[];
+#endif
+
+#endif /* __MIRROR_H__ */
@@ -0,0 +1,139 @@
+#include <avr/interrupt.h>
+#include "sound.h"
+
+#if defined(ENABLE_SOUND)
+
+/* one period of a sine, 32 unsigned samples */
+static const uint8_t sine32[] PROGMEM =
+{
+	0x80, 0x98, 0xB0, 0xC7, 0xDA, 0xEA, 0xF6, 0xFD,
+	0xFF, 0xFD, 0xF6, 0xEA, 0xDA, 0xC7, 0xB0, 0x98,
+	0x80, 0x67, 0x4F, 0x38, 0x25, 0x15, 0x09, 0x02,
+	0x00, 0x02, 0x09, 0x15, 0x25, 0x38, 0x4F, 0x67
+};
+
+/* NTSC until sound_begin so the rate is never 0 */
+static uint16_t snd_rate = NTSC_LINE_RATE;
+
+/* tone channel */
+static const uint8_t *snd_wave = sine32;
+static uint16_t snd_phase, snd_inc;
+static volatile uint16_t snd_tone_len;
+
+/* PROGMEM sample channel, 8.8 fixed point step */
+static const uint8_t *snd_pcm;
+static uint16_t snd_step;
+static uint8_t snd_frac;
+static volatile uint16_t snd_pcm_len;
+
+/* sample queue, the main loop only writes snd_head */
+static uint8_t snd_queue[SND_QUEUE];
+static volatile uint8_t snd_head, snd_tail;
+
+void sound_begin(uint8_t mode)
+{
+	snd_rate = (mode & PAL) ? PAL_LINE_RATE : NTSC_LINE_RATE;
+	SND_DDR |= (1 << SND_PIN);
+	OCR2A = 0x80;
+	TCCR2A = (1 << COM2A1) | (1 << WGM21) | (1 << WGM20);
+	TCCR2B = (1 << CS20);
+}
+
+/* 32 samples, PROGMEM */
+void sound_wave(const uint8_t *table)
+{
+	snd_wave = table;
+}
+
+void sound_tone(uint16_t freq, uint16_t ms)
+{
+	uint16_t inc, len;
+	inc = ((uint32_t)freq << 16) / snd_rate;
+	len = ((uint32_t)ms * snd_rate) / 1000;
+	cli();
+	snd_inc = inc;
+	snd_tone_len = len;
+	sei();
+}
+
+/* unsigned 8 bit samples in PROGMEM, rate in Hz */
+void sound_play(const uint8_t *pcm, uint16_t len, uint16_t rate)
+{
+	uint16_t step = ((uint32_t)rate << 8) / snd_rate;
+	cli();
+	snd_pcm = pcm;
+	snd_step = step;
+	snd_frac = 0;
+	snd_pcm_len = len;
+	sei();
+}
+
+void sound_stop(void)
+{
+	cli();
+	snd_tone_len = 0;
+	snd_pcm_len = 0;
+	snd_tail = snd_head;
+	sei();
+}
+
+/* one sample at the line rate, returns 0 if the queue is full */
+uint8_t sound_write(uint8_t sample)
+{
+	uint8_t h = (snd_head + 1) & (SND_QUEUE - 1);
+	if(h == snd_tail)
+	{
+		return 0;
+	}
+
+	snd_queue[snd_head] = sample;
+	snd_head = h;
+	return 1;
+}
+
+uint8_t sound_busy(void)
+{
+	return snd_tone_len || snd_pcm_len || snd_head != snd_tail;
+}
+
+/* called from the line interrupt once per scanline, the tone and the
+   sample channel are mixed by averaging when both are playing */
+void sound_tick(void)
+{
+	uint16_t s = 0;
+	uint8_t n = 0, adv;
+	if(snd_tone_len)
+	{
+		--snd_tone_len;
+		snd_phase += snd_inc;
+		s = pgm_read_byte(snd_wave + (snd_phase >> 11));
+		++n;
+	}
+
+	if(snd_pcm_len)
+	{
+		s += pgm_read_byte(snd_pcm);
+		++n;
+		snd_frac += snd_step & 0xFF;
+		adv = (snd_step >> 8) + (snd_frac < (snd_step & 0xFF));
+		if(adv >= snd_pcm_len)
+		{
+			snd_pcm_len = 0;
+		}
+		else
+		{
+			snd_pcm += adv;
+			snd_pcm_len -= adv;
+		}
+	}
+	else if(snd_tail != snd_head)
+	{
+		s += snd_queue[snd_tail];
+		snd_tail = (snd_tail + 1) & (SND_QUEUE - 1);
+		++n;
+	}
+
+	OCR2A = (n == 2) ? (s >> 1) : (n ? s : 0x80);
+}
+
+#endif /* ENABLE_SOUND */
@@ -0,0 +1,19 @@
+#ifndef __SOUND_H__
+#define __SOUND_H__
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "video_conf.h"
+
+void sound_begin(uint8_t mode);
+void sound_wave(const uint8_t *table);
+void sound_tone(uint16_t freq, uint16_t ms);
+void sound_play(const uint8_t *pcm, uint16_t len, uint16_t rate);
+void sound_stop(void);
+uint8_t sound_write(uint8_t sample);
+uint8_t sound_busy(void);
+
+void sound_tick(void);
+
+#endif /* __SOUND_H__ */
@@ -0,0 +1,549 @@
+#include <avr/interrupt.h>
+#include "video.h"
+#include "terminal.h"
+
+#if defined(ENABLE_TERMINAL)
+
+#define TERM_UBRR ((F_CPU / 8 + TERM_BAUD / 2) / TERM_BAUD - 1)
+
+extern uint8_t frame[];
+
+/* receive ring, the line interrupt only writes term_head */
+static uint8_t term_ring[TERM_RX];
+static volatile uint8_t term_head, term_tail;
+static volatile uint16_t term_drop;
+
+/* cursor, text line at the top of the screen and escape parser */
+static uint8_t term_col, term_row, term_top, term_inv, term_cur;
+static uint8_t term_scol, term_srow;
+static uint8_t term_esc, term_npar, term_par[4];
+
+static uint8_t *term_line(uint8_t row)
+{
+	row += term_top;
+	if(row >= TERM_ROWS)
+	{
+		row -= TERM_ROWS;
+	}
+
+#if defined(ENABLE_DIRTY)
+	video_dirty_mark(row * 8, row * 8 + 8);
+#endif
+	return frame + row * (8 * WIDTH);
+}
+
+/* 8 rows of a 6 pixel cell at column col, bits 7 - 2 of each byte in
+   rows as in font5x7, rows == 0 draws a blank cell */
+static void term_cell(uint8_t col, uint8_t row, const uint8_t *rows,
+	uint8_t inv)
+{
+	uint8_t *p, k, s, mul, b;
+	uint16_t v, m;
+	uint16_t x = col * 6;
+	p = term_line(row) + (x >> 3);
+	s = x & 7;
+	mul = s ? (1 << (8 - s)) : 0;
+	m = s ? (uint16_t)0xFC * mul : 0xFC00;
+	for(k = 0; k < 8; ++k, p += WIDTH)
+	{
+		b = rows ? pgm_read_byte(rows + k) : 0;
+		b ^= inv;
+		v = s ? (uint16_t)b * mul : (uint16_t)b << 8;
+		p[0] = (p[0] & ~(m >> 8)) | ((v >> 8) & (m >> 8));
+		if((uint8_t)m)
+		{
+			p[1] = (p[1] & ~(uint8_t)m) | ((uint8_t)v & (uint8_t)m);
+		}
+	}
+}
+
+static void term_glyph(uint8_t col, uint8_t row, char c)
+{
+	video_font_t h;
+	uint8_t g;
+	memcpy_P(&h, &font5x7, sizeof(h));
+	if((g = video_font_glyph(&h, c)) == 0xFF)
+	{
+		g = video_font_glyph(&h, '?');
+	}
+
+	term_cell(col, row, h.bitmap + pgm_read_word(h.offset + g), term_inv);
+}
+
+static void term_clear_line(uint8_t row, uint8_t from, uint8_t to)
+{
+	uint8_t *p, *end;
+	if(!from && to >= TERM_COLS)
+	{
+		p = term_line(row);
+		for(end = p + 8 * WIDTH; p < end; ++p)
+		{
+			*p = 0;
+		}
+
+		return;
+	}
+
+	for(; from < to && from < TERM_COLS; ++from)
+	{
+		term_cell(from, row, 0, 0);
+	}
+}
+
+/* underline cursor, drawn with XOR */
+static void term_cursor(void)
+{
+	uint8_t *p, s;
+	uint16_t x, m;
+	if(term_col >= TERM_COLS)
+	{
+		return;
+	}
+
+	x = term_col * 6;
+	p = term_line(term_row) + (x >> 3) + 7 * WIDTH;
+	s = x & 7;
+	m = (uint16_t)0xFC00 >> s;
+	p[0] ^= m >> 8;
+	if((uint8_t)m)
+	{
+		p[1] ^= (uint8_t)m;
+	}
+}
+
+/* moves the origin instead of the framebuffer */
+static void term_scroll_up(void)
+{
+	if(++term_top >= TERM_ROWS)
+	{
+		term_top = 0;
+	}
+
+	video_set_origin(term_top * 8);
+	term_clear_line(TERM_ROWS - 1, 0, TERM_COLS);
+}
+
+static void term_scroll_down(void)
+{
+	term_top = term_top ? term_top - 1 : TERM_ROWS - 1;
+	video_set_origin(term_top * 8);
+	term_clear_line(0, 0, TERM_COLS);
+}
+
+static void term_newline(void)
+{
+	if(term_row + 1 >= TERM_ROWS)
+	{
+		term_scroll_up();
+	}
+	else
+	{
+		++term_row;
+	}
+}
+
+static uint8_t term_arg(uint8_t i, uint8_t def)
+{
+	return (i < term_npar && term_par[i]) ? term_par[i] : def;
+}
+
+static void term_csi(char c)
+{
+	uint8_t i, n = term_arg(0, 1);
+	switch(c)
+	{
+		case 'A':
+		{
+			term_row = (term_row > n) ? term_row - n : 0;
+			break;
+		}
+
+		case 'B':
+		{
+			term_row = (term_row + n < TERM_ROWS) ? term_row + n :
+				TERM_ROWS - 1;
+			break;
+		}
+
+		case 'C':
+		{
+			term_col = (term_col + n < TERM_COLS) ? term_col + n :
+				TERM_COLS - 1;
+			break;
+		}
+
+		case 'D':
+		{
+			term_col = (term_col > n) ? term_col - n : 0;
+			break;
+		}
+
+		case 'H':
+		case 'f':
+		{
+			term_row = term_arg(0, 1) - 1;
+			term_col = term_arg(1, 1) - 1;
+			if(term_row >= TERM_ROWS)
+			{
+				term_row = TERM_ROWS - 1;
+			}
+
+			if(term_col >= TERM_COLS)
+			{
+				term_col = TERM_COLS - 1;
+			}
+
+			break;
+		}
+
+		case 'J':
+		{
+			n = term_arg(0, 0);
+			if(n != 1)
+			{
+				term_clear_line(term_row, n ? 0 : term_col, TERM_COLS);
+				for(i = term_row + 1; i < TERM_ROWS; ++i)
+				{
+					term_clear_line(i, 0, TERM_COLS);
+				}
+			}
+
+			if(n)
+			{
+				for(i = 0; i < term_row; ++i)
+				{
+					term_clear_line(i, 0, TERM_COLS);
+				}
+
+				term_clear_line(term_row, 0,
+					n == 1 ? term_col + 1 : TERM_COLS);
+			}
+
+			break;
+		}
+
+		case 'K':
+		{
+			n = term_arg(0, 0);
+			term_clear_line(term_row, n ? 0 : term_col,
+				n == 1 ? term_col + 1 : TERM_COLS);
+			break;
+		}
+
+		case 'm':
+		{
+			for(i = 0; i < term_npar || !i; ++i)
+			{
+				if(term_par[i] == 0)
+				{
+					term_inv = 0;
+				}
+				else if(term_par[i] == 7)
+				{
+					term_inv = 0xFC;
+				}
+			}
+
+			break;
+		}
+
+		case 's':
+		{
+			term_scol = term_col;
+			term_srow = term_row;
+			break;
+		}
+
+		case 'u':
+		{
+			term_col = term_scol;
+			term_row = term_srow;
+			break;
+		}
+	}
+}
+
+static void term_char(char c)
+{
+	if(term_esc == 1)
+	{
+		term_esc = 0;
+		switch(c)
+		{
+			case '[':
+			{
+				term_esc = 2;
+				term_npar = 0;
+				term_par[0] = 0;
+				break;
+			}
+
+			case 'D':
+			{
+				term_newline();
+				break;
+			}
+
+			case 'M':
+			{
+				if(term_row)
+				{
+					--term_row;
+				}
+				else
+				{
+					term_scroll_down();
+				}
+
+				break;
+			}
+
+			case 'E':
+			{
+				term_col = 0;
+				term_newline();
+				break;
+			}
+
+			case '7':
+			{
+				term_scol = term_col;
+				term_srow = term_row;
+				break;
+			}
+
+			case '8':
+			{
+				term_col = term_scol;
+				term_row = term_srow;
+				break;
+			}
+
+			case 'c':
+			{
+				term_begin();
+				break;
+			}
+		}
+
+		return;
+	}
+
+	if(term_esc == 2)
+	{
+		if(c >= '0' && c <= '9')
+		{
+			if(!term_npar)
+			{
+				term_npar = 1;
+			}
+
+			if(term_npar <= 4)
+			{
+				term_par[term_npar - 1] =
+					term_par[term_npar - 1] * 10 + (c - '0');
+			}
+		}
+		else if(c == ';')
+		{
+			if(!term_npar)
+			{
+				term_npar = 1;
+			}
+
+			if(++term_npar <= 4)
+			{
+				term_par[term_npar - 1] = 0;
+			}
+		}
+		else if(c >= 0x40)
+		{
+			if(term_npar > 4)
+			{
+				term_npar = 4;
+			}
+
+			term_esc = 0;
+			term_csi(c);
+		}
+
+		/* '?' and other intermediates are ignored */
+		return;
+	}
+
+	switch(c)
+	{
+		case 0x1B:
+		{
+			term_esc = 1;
+			break;
+		}
+
+		case '\r':
+		{
+			term_col = 0;
+			break;
+		}
+
+		case '\n':
+		case '\v':
+		case '\f':
+		{
+			term_newline();
+			break;
+		}
+
+		case '\b':
+		{
+			if(term_col)
+			{
+				--term_col;
+			}
+
+			break;
+		}
+
+		case '\t':
+		{
+			term_col = (term_col + 8) & ~7;
+			if(term_col >= TERM_COLS)
+			{
+				term_col = TERM_COLS - 1;
+			}
+
+			break;
+		}
+
+		default:
+		{
+			if(c < 32)
+			{
+				break;
+			}
+
+			if(term_col >= TERM_COLS)
+			{
+				term_col = 0;
+				term_newline();
+			}
+
+			term_glyph(term_col++, term_row, c);
+			break;
+		}
+	}
+}
+
+void term_begin(void)
+{
+	uint8_t i;
+	UBRR0 = TERM_UBRR;
+	UCSR0A = (1 << U2X0);
+	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+	UCSR0B = (1 << RXEN0) | (1 << TXEN0);
+
+	term_top = 0;
+	video_set_origin(0);
+	for(i = 0; i < TERM_ROWS; ++i)
+	{
+		term_clear_line(i, 0, TERM_COLS);
+	}
+
+	term_col = term_row = term_inv = term_esc = 0;
+	term_cur = 0;
+}
+
+/* processes everything received so far, call it from the main loop */
+void term_task(void)
+{
+	if(term_tail == term_head)
+	{
+		if(!term_cur)
+		{
+			term_cursor();
+			term_cur = 1;
+		}
+
+		return;
+	}
+
+	if(term_cur)
+	{
+		term_cursor();
+		term_cur = 0;
+	}
+
+	while(term_tail != term_head)
+	{
+		term_char(term_ring[term_tail]);
+		term_tail = (term_tail + 1) & (TERM_RX - 1);
+	}
+}
+
+/* local output, bypasses the receive ring */
+void term_putc(char c)
+{
+	if(term_cur)
+	{
+		term_cursor();
+		term_cur = 0;
+	}
+
+	term_char(c);
+}
+
+void term_puts(const char *s)
+{
+	while(*s)
+	{
+		term_putc(*s++);
+	}
+}
+
+void term_send(char c)
+{
+	while(!(UCSR0A & (1 << UDRE0)))
+	{
+	}
+
+	UDR0 = c;
+}
+
+/* bytes lost to a full ring or a USART overrun */
+uint16_t term_lost(void)
+{
+	uint16_t n;
+	cli();
+	n = term_drop;
+	sei();
+	return n;
+}
+
+/* called at the end of every line interrupt, after the pixels are out.
+   A line is shorter than a byte at 115200 baud, so the USART does not
+   overrun and no RX interrupt can hit an active line. The ring still
+   fills up if term_task falls behind, see term_lost */
+void term_rx(void)
+{
+	uint8_t h;
+	while(UCSR0A & (1 << RXC0))
+	{
+		if(UCSR0A & (1 << DOR0))
+		{
+			++term_drop;
+		}
+
+		h = (term_head + 1) & (TERM_RX - 1);
+		if(h == term_tail)
+		{
+			(void)UDR0;
+			++term_drop;
+		}
+		else
+		{
+			term_ring[term_head] = UDR0;
+			term_head = h;
+		}
+	}
+}
+
+#endif /* ENABLE_TERMINAL */
@@ -0,0 +1,21 @@
+#ifndef __TERMINAL_H__
+#define __TERMINAL_H__
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "video_conf.h"
+
+#define TERM_COLS (PWIDTH / 6)
+#define TERM_ROWS (HEIGHT / 8)
+
+void term_begin(void);
+void term_task(void);
+void term_putc(char c);
+void term_puts(const char *s);
+void term_send(char c);
+uint16_t term_lost(void);
+
+void term_rx(void);
+
+#endif /* __TERMINAL_H__ */
@@ -0,0 +1,639 @@
+/* font compiler: turns a BDF font or a PNG glyph sheet into the PROGMEM
+   tables of a video_font_t. Glyphs are stored row major, (width + 7) / 8
+   bytes per row with the leftmost pixel in bit 7, like the framebuffer,
+   so video_text can merge them a byte at a time.
+
+   cc -O2 -o fontc tools/fontc.c -lz
+   ./fontc -n font_big -x 2 -c 0123456789.-: fonts/5x7.bdf > font_big.c
+   ./fontc -n font_sheet -g 8x12 -f 32 sheet.png > font_sheet.c
+
+   -n name   symbol of the font, default font
+   -c chars  only these characters
+   -x scale  every pixel becomes scale x scale pixels
+   -g WxH    cell size of a PNG sheet, glyphs left to right and top to
+             bottom from -f (default 32)
+   -m        PNG: keep the cell width instead of the width of the ink
+   -i        PNG: light glyphs on a dark background, for images
+             without an alpha channel
+
+   Without -m the width of a PNG glyph is its rightmost ink column plus
+   one column of spacing, empty cells get half the cell width. BDF
+   glyphs keep their DWIDTH. */
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+typedef struct
+{
+	int width;
+	uint8_t *pix;
+} glyph_t;
+
+static glyph_t glyphs[256];
+static int height;
+
+static void *alloc(size_t n)
+{
+	void *p = calloc(1, n);
+	if(!p)
+	{
+		fprintf(stderr, "fontc: out of memory\n");
+		exit(1);
+	}
+
+	return p;
+}
+
+static void fail(const char *path, const char *msg)
+{
+	fprintf(stderr, "fontc: %s: %s\n", path, msg);
+	exit(1);
+}
+
+static uint8_t *read_file(const char *path, size_t *len)
+{
+	FILE *f;
+	uint8_t *buf;
+	long n;
+	if(!(f = fopen(path, "rb")))
+	{
+		perror(path);
+		exit(1);
+	}
+
+	fseek(f, 0, SEEK_END);
+	n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	buf = alloc(n + 1);
+	if(fread(buf, 1, n, f) != (size_t)n)
+	{
+		fail(path, "read error");
+	}
+
+	fclose(f);
+	*len = n;
+	return buf;
+}
+
+/* ---- BDF ---- */
+
+static void load_bdf(const char *path)
+{
+	char line[1024], *s;
+	FILE *f;
+	int ascent = -1, descent = -1, fh = 0, fy = 0;
+	int enc = -1, dw = 0, bw = 0, bh = 0, bx = 0, by = 0;
+	int row, i, x, y, d;
+	glyph_t *g = 0;
+	if(!(f = fopen(path, "r")))
+	{
+		perror(path);
+		exit(1);
+	}
+
+	while(fgets(line, sizeof(line), f))
+	{
+		if(sscanf(line, "FONTBOUNDINGBOX %*d %d %*d %d", &fh, &fy) == 2)
+		{
+			continue;
+		}
+
+		if(sscanf(line, "FONT_ASCENT %d", &ascent) == 1 ||
+			sscanf(line, "FONT_DESCENT %d", &descent) == 1 ||
+			sscanf(line, "ENCODING %d", &enc) == 1 ||
+			sscanf(line, "DWIDTH %d", &dw) == 1 ||
+			sscanf(line, "BBX %d %d %d %d", &bw, &bh, &bx, &by) == 4)
+		{
+			continue;
+		}
+
+		if(strncmp(line, "BITMAP", 6))
+		{
+			continue;
+		}
+
+		if(ascent < 0 || descent < 0)
+		{
+			ascent = fh + fy;
+			descent = -fy;
+		}
+
+		height = ascent + descent;
+		if(height <= 0 || height > 255)
+		{
+			fail(path, "bad font height");
+		}
+
+		g = (enc >= 0 && enc < 256 && dw > 0 && dw < 256) ?
+			&glyphs[enc] : 0;
+		if(g)
+		{
+			free(g->pix);
+			g->width = dw;
+			g->pix = alloc(dw * height);
+		}
+
+		/* rows of the BBX, bit 7 of the first byte is column bx */
+		for(row = 0; row < bh && fgets(line, sizeof(line), f); ++row)
+		{
+			for(s = line; isspace((unsigned char)*s); ++s)
+			{
+			}
+
+			y = ascent - (by + bh) + row;
+			for(i = 0; g && i < bw && isxdigit((unsigned char)s[i / 4]); ++i)
+			{
+				d = isdigit((unsigned char)s[i / 4]) ? s[i / 4] - '0' :
+					(tolower((unsigned char)s[i / 4]) - 'a' + 10);
+				x = bx + i;
+				if(x >= 0 && x < dw && y >= 0 && y < height &&
+					(d >> (3 - i % 4) & 1))
+				{
+					g->pix[y * dw + x] = 1;
+				}
+			}
+		}
+
+		enc = -1;
+	}
+
+	fclose(f);
+	if(!height)
+	{
+		fail(path, "no glyphs");
+	}
+}
+
+/* ---- PNG ---- */
+
+static uint32_t be32(const uint8_t *p)
+{
+	return (uint32_t)p[0] << 24 | p[1] << 16 | p[2] << 8 | p[3];
+}
+
+static int paeth(int a, int b, int c)
+{
+	int p = a + b - c, pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+	return (pa <= pb && pa <= pc) ? a : (pb <= pc) ? b : c;
+}
+
+/* decodes a non interlaced PNG into one ink flag per pixel: opaque
+   pixels of images with alpha, otherwise dark ones */
+static uint8_t *load_png(const char *path, int *w, int *h, int invert)
+{
+	static const int chans[] = { 1, 0, 3, 1, 2, 0, 4 };
+	uint8_t *file, *p, *end, *idat = 0, *raw, *ink, plte[768], trns[256];
+	size_t len, nidat = 0;
+	uLongf rawlen;
+	uint32_t n;
+	int depth = 0, type = 0, ch, bpp, stride, x, y, i, v, a, lum;
+	memset(trns, 255, sizeof(trns));
+	memset(plte, 0, sizeof(plte));
+	file = read_file(path, &len);
+	if(len < 8 || memcmp(file, "\x89PNG\r\n\x1a\n", 8))
+	{
+		fail(path, "not a PNG");
+	}
+
+	for(p = file + 8, end = file + len; p + 12 <= end; p += n + 12)
+	{
+		n = be32(p);
+		if(p + 12 + n > end)
+		{
+			fail(path, "truncated");
+		}
+
+		if(!memcmp(p + 4, "IHDR", 4))
+		{
+			*w = be32(p + 8);
+			*h = be32(p + 12);
+			depth = p[16];
+			type = p[17];
+			if(p[20])
+			{
+				fail(path, "interlaced PNG");
+			}
+		}
+		else if(!memcmp(p + 4, "PLTE", 4))
+		{
+			memcpy(plte, p + 8, n < 768 ? n : 768);
+		}
+		else if(!memcmp(p + 4, "tRNS", 4) && type == 3)
+		{
+			memcpy(trns, p + 8, n < 256 ? n : 256);
+		}
+		else if(!memcmp(p + 4, "IDAT", 4))
+		{
+			if(!(idat = realloc(idat, nidat + n)))
+			{
+				fail(path, "out of memory");
+			}
+
+			memcpy(idat + nidat, p + 8, n);
+			nidat += n;
+		}
+	}
+
+	if(type > 6 || !(ch = chans[type]) || !*w || !*h)
+	{
+		fail(path, "unsupported PNG");
+	}
+
+	bpp = (ch * depth + 7) / 8;
+	stride = (*w * ch * depth + 7) / 8;
+	rawlen = (uLongf)(stride + 1) * *h;
+	raw = alloc(rawlen);
+	if(uncompress(raw, &rawlen, idat, nidat) != Z_OK ||
+		rawlen != (uLongf)(stride + 1) * *h)
+	{
+		fail(path, "bad image data");
+	}
+
+	/* undo the filters in place, row y starts after its filter byte */
+	for(y = 0; y < *h; ++y)
+	{
+		uint8_t *r = raw + y * (stride + 1) + 1;
+		uint8_t *u = y ? r - stride - 1 : 0;
+		for(x = 0; x < stride; ++x)
+		{
+			int l = x >= bpp ? r[x - bpp] : 0, up = u ? u[x] : 0;
+			int ul = (u && x >= bpp) ? u[x - bpp] : 0;
+			switch(r[-1])
+			{
+				case 1: r[x] += l; break;
+				case 2: r[x] += up; break;
+				case 3: r[x] += (l + up) / 2; break;
+				case 4: r[x] += paeth(l, up, ul); break;
+			}
+		}
+	}
+
+	ink = alloc(*w * *h);
+	for(y = 0; y < *h; ++y)
+	{
+		uint8_t *r = raw + y * (stride + 1) + 1;
+		for(x = 0; x < *w; ++x)
+		{
+			/* samples of pixel x scaled to 8 bits */
+			int s[4];
+			for(i = 0; i < ch; ++i)
+			{
+				int bit = (x * ch + i) * depth;
+				if(depth >= 8)
+				{
+					s[i] = r[bit / 8];
+				}
+				else
+				{
+					v = (r[bit / 8] >> (8 - depth - bit % 8)) &
+						((1 << depth) - 1);
+					s[i] = (type == 3) ? v : v * 255 / ((1 << depth) - 1);
+				}
+			}
+
+			a = 255;
+			switch(type)
+			{
+				case 0: lum = s[0]; break;
+				case 2: lum = (s[0] * 3 + s[1] * 6 + s[2]) / 10; break;
+				case 3:
+					lum = (plte[s[0] * 3] * 3 + plte[s[0] * 3 + 1] * 6 +
+						plte[s[0] * 3 + 2]) / 10;
+					a = trns[s[0]];
+					break;
+				case 4: lum = s[0]; a = s[1]; break;
+				default:
+					lum = (s[0] * 3 + s[1] * 6 + s[2]) / 10;
+					a = s[3];
+					break;
+			}
+
+			/* with an alpha channel only the alpha counts */
+			ink[y * *w + x] = (type & 4) ? a >= 128 :
+				a >= 128 && (invert ? lum >= 128 : lum < 128);
+		}
+	}
+
+	free(raw);
+	free(idat);
+	free(file);
+	return ink;
+}
+
+static void load_sheet(const char *path, int cw, int chh, int first,
+	int mono, int invert)
+{
+	uint8_t *ink;
+	int w, h, cols, k, c, x, y, right;
+	glyph_t *g;
+	ink = load_png(path, &w, &h, invert);
+	if(cw <= 0 || chh <= 0 || cw > 255 || chh > 255 || cw > w || chh > h)
+	{
+		fail(path, "bad cell size");
+	}
+
+	height = chh;
+	cols = w / cw;
+	for(k = 0; k < cols * (h / chh) && first + k < 256; ++k)
+	{
+		c = first + k;
+		g = &glyphs[c];
+		g->pix = alloc(cw * chh);
+		for(y = 0, right = -1; y < chh; ++y)
+		{
+			for(x = 0; x < cw; ++x)
+			{
+				if(ink[((k / cols) * chh + y) * w + (k % cols) * cw + x])
+				{
+					g->pix[y * cw + x] = 1;
+					if(x > right)
+					{
+						right = x;
+					}
+				}
+			}
+		}
+
+		g->width = mono ? cw : (right < 0) ? cw / 2 :
+			(right + 2 < cw ? right + 2 : cw);
+
+		/* the pixels stay at stride cw, repack them to the width */
+		for(y = 1; y < chh && g->width != cw; ++y)
+		{
+			memmove(g->pix + y * g->width, g->pix + y * cw, g->width);
+		}
+	}
+
+	free(ink);
+}
+
+/* ---- output ---- */
+
+static void scale_glyphs(int s)
+{
+	int c, x, y, w;
+	uint8_t *p;
+	for(c = 0; c < 256; ++c)
+	{
+		if(!glyphs[c].pix)
+		{
+			continue;
+		}
+
+		w = glyphs[c].width * s;
+		if(w > 255)
+		{
+			fail("scale", "glyph wider than 255 pixels");
+		}
+
+		p = alloc(w * height * s);
+		for(y = 0; y < height * s; ++y)
+		{
+			for(x = 0; x < w; ++x)
+			{
+				p[y * w + x] =
+					glyphs[c].pix[(y / s) * glyphs[c].width + x / s];
+			}
+		}
+
+		free(glyphs[c].pix);
+		glyphs[c].pix = p;
+		glyphs[c].width = w;
+	}
+
+	height *= s;
+	if(height > 255)
+	{
+		fail("scale", "font taller than 255 pixels");
+	}
+}
+
+static void put_char(int c)
+{
+	if(c >= 32 && c < 127)
+	{
+		printf(" /* %c */\n", c);
+	}
+	else
+	{
+		printf(" /* 0x%02X */\n", c);
+	}
+}
+
+/* separator in front of item i of a list with n per line */
+static const char *sep(int i, int n)
+{
+	return !i ? "" : (i % n) ? ", " : ",\n\t";
+}
+
+static void emit(const char *name, const char *src)
+{
+	int c, first = -1, last = -1, n = 0, gaps = 0, x, y, i, b, bytes;
+	long offset = 0;
+	glyph_t *g;
+	for(c = 0; c < 256; ++c)
+	{
+		if(glyphs[c].pix)
+		{
+			if(first < 0)
+			{
+				first = c;
+			}
+
+			gaps += c - last - 1;
+			last = c;
+			++n;
+		}
+	}
+
+	if(!n)
+	{
+		fail(src, "no glyphs left");
+	}
+
+	gaps -= first;
+	printf("/* generated by tools/fontc from %s, do not edit */\n\n", src);
+	printf("#include \"video.h\"\n\n");
+	if(gaps)
+	{
+		printf("static const uint8_t %s_map[] PROGMEM =\n{\n", name);
+		for(c = first, i = 0; c <= last; ++c)
+		{
+			printf("\t%d,", glyphs[c].pix ? i++ : 255);
+			put_char(c);
+		}
+
+		printf("};\n\n");
+	}
+
+	printf("static const uint8_t %s_width[] PROGMEM =\n{\n\t", name);
+	for(c = first, i = 0; c <= last; ++c)
+	{
+		if(glyphs[c].pix)
+		{
+			printf("%s%d", sep(i++, 16), glyphs[c].width);
+		}
+	}
+
+	printf("\n};\n\nstatic const uint16_t %s_offset[] PROGMEM =\n{\n\t",
+		name);
+	for(c = first, i = 0; c <= last; ++c)
+	{
+		if(glyphs[c].pix)
+		{
+			printf("%s%ld", sep(i++, 12), offset);
+			offset += (long)(glyphs[c].width + 7) / 8 * height;
+		}
+	}
+
+	if(offset > 65535)
+	{
+		fail(src, "more than 64 KiB of glyphs");
+	}
+
+	printf("\n};\n\nstatic const uint8_t %s_bitmap[] PROGMEM =\n{\n", name);
+	for(c = first; c <= last; ++c)
+	{
+		if(!(g = &glyphs[c])->pix)
+		{
+			continue;
+		}
+
+		bytes = (g->width + 7) / 8;
+		for(y = 0; y < height; ++y)
+		{
+			printf("\t");
+			for(i = 0; i < bytes; ++i)
+			{
+				for(x = 0, b = 0; x < 8; ++x)
+				{
+					b <<= 1;
+					if(i * 8 + x < g->width && g->pix[y * g->width + i * 8 + x])
+					{
+						b |= 1;
+					}
+				}
+
+				printf("%s0x%02X,", i ? " " : "", b);
+			}
+
+			if(y)
+			{
+				printf("\n");
+			}
+			else
+			{
+				put_char(c);
+			}
+		}
+	}
+
+	printf("};\n\nconst video_font_t %s PROGMEM =\n{\n", name);
+	printf("\t%d, %d, %d,\n", height, first, last);
+	printf("\t%s%s, %s_width, %s_offset, %s_bitmap\n};\n",
+		gaps ? name : "0", gaps ? "_map" : "", name, name, name);
+}
+
+static void usage(const char *argv0)
+{
+	fprintf(stderr, "usage: %s [-n name] [-c chars] [-x scale] "
+		"[-g WxH [-f first] [-m] [-i]] font.bdf|sheet.png\n", argv0);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *name = "font", *chars = 0, *path = 0;
+	int i, c, scale = 1, cw = 0, ch = 0, first = 32, mono = 0, inv = 0;
+	size_t len;
+	for(i = 1; i < argc; ++i)
+	{
+		if(argv[i][0] != '-' || !argv[i][1])
+		{
+			path = argv[i];
+		}
+		else if(!strcmp(argv[i], "-m"))
+		{
+			mono = 1;
+		}
+		else if(!strcmp(argv[i], "-i"))
+		{
+			inv = 1;
+		}
+		else if(i + 1 >= argc)
+		{
+			usage(argv[0]);
+		}
+		else if(!strcmp(argv[i], "-n"))
+		{
+			name = argv[++i];
+		}
+		else if(!strcmp(argv[i], "-c"))
+		{
+			chars = argv[++i];
+		}
+		else if(!strcmp(argv[i], "-x"))
+		{
+			scale = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "-f"))
+		{
+			first = atoi(argv[++i]);
+		}
+		else if(!strcmp(argv[i], "-g"))
+		{
+			if(sscanf(argv[++i], "%dx%d", &cw, &ch) != 2)
+			{
+				usage(argv[0]);
+			}
+		}
+		else
+		{
+			usage(argv[0]);
+		}
+	}
+
+	if(!path || scale < 1 || first < 0 || first > 255)
+	{
+		usage(argv[0]);
+	}
+
+	len = strlen(path);
+	if(len > 4 && !strcmp(path + len - 4, ".png"))
+	{
+		if(!cw)
+		{
+			fail(path, "a PNG sheet needs -g WxH");
+		}
+
+		load_sheet(path, cw, ch, first, mono, inv);
+	}
+	else
+	{
+		load_bdf(path);
+	}
+
+	if(chars)
+	{
+		for(c = 0; c < 256; ++c)
+		{
+			if(glyphs[c].pix && (!c || !strchr(chars, c)))
+			{
+				free(glyphs[c].pix);
+				glyphs[c].pix = 0;
+			}
+		}
+	}
+
+	if(scale > 1)
+	{
+		scale_glyphs(scale);
+	}
+
+	emit(name, path);
+	return 0;
+}
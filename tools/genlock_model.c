@@ -0,0 +1,156 @@
+/* host model of the ENABLE_GENLOCK line loop: Timer1 with its double
+   buffered TOP, the input capture of the sync edges of a signal whose
+   line period is off by a given amount, and the arithmetic of
+   genlock_hsync in video.c. Plain line syncs only, no vertical
+   interval. Prints the lines until the loop is locked and the largest
+   phase error after that.
+
+   cc -O2 -o genlock_model tools/genlock_model.c
+   ./genlock_model [ppm] [lines] [handler cycles] */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* video_conf.h at 16 MHz, NTSC */
+#define CYCLES_LINE    1016
+#define GENLOCK_TOL       8
+#define GENLOCK_LINES    16
+#define GENLOCK_RANGE    64
+
+/* the timer */
+static uint16_t ocr1a, icr1;
+static uint8_t icf1;
+
+/* the loop, as in video.c */
+static int16_t gl_trim, gl_err;
+static uint8_t gl_lock;
+static uint16_t gl_top;
+
+static void genlock_hsync(void)
+{
+	uint16_t top = gl_top;
+	int16_t e;
+	gl_top = ocr1a;
+	if(!icf1)
+	{
+		gl_lock = 0;
+		return;
+	}
+
+	e = icr1;
+	icf1 = 0;
+	if(e > (int16_t)(top / 2))
+	{
+		e -= top + 1;
+	}
+
+	if(gl_lock >= GENLOCK_LINES &&
+		(e > (int16_t)(CYCLES_LINE / 4) || e < -(int16_t)(CYCLES_LINE / 4)))
+	{
+		return;
+	}
+
+	gl_err = e;
+	gl_trim += e;
+	if(gl_trim > GENLOCK_RANGE * 16)
+	{
+		gl_trim = GENLOCK_RANGE * 16;
+	}
+	else if(gl_trim < -GENLOCK_RANGE * 16)
+	{
+		gl_trim = -GENLOCK_RANGE * 16;
+	}
+
+	ocr1a = CYCLES_LINE + (gl_trim >> 4) + (e >> 1);
+	if(e > GENLOCK_TOL || e < -GENLOCK_TOL)
+	{
+		gl_lock = 0;
+	}
+	else if(gl_lock < 0xFF)
+	{
+		++gl_lock;
+	}
+}
+
+/* captures the edges from the line start at t up to t + end */
+static void capture(double t, double end, double period, double *edge)
+{
+	while(*edge < t + end)
+	{
+		icr1 = (uint16_t)(*edge - t);
+		icf1 = 1;
+		*edge += period;
+	}
+}
+
+/* one run from the given start phase, returns the first locked line
+   or -1, and the largest error once locked */
+static long run(double period, double phase, long lines, int handler,
+	int *worst)
+{
+	double t = 0, edge = phase;
+	long n, locked = -1;
+	uint16_t top;
+	gl_trim = gl_err = 0;
+	gl_lock = 0;
+	icf1 = 0;
+	ocr1a = gl_top = CYCLES_LINE;
+	*worst = 0;
+	for(n = 0; n < lines; ++n)
+	{
+		/* the buffered TOP is loaded at the start of the line */
+		top = ocr1a;
+		capture(t, handler, period, &edge);
+		genlock_hsync();
+		capture(t, top + 1, period, &edge);
+		t += top + 1;
+		if(locked < 0 && gl_lock >= GENLOCK_LINES)
+		{
+			locked = n;
+		}
+		else if(locked >= 0 && abs(gl_err) > *worst)
+		{
+			*worst = abs(gl_err);
+		}
+	}
+
+	return locked;
+}
+
+int main(int argc, char **argv)
+{
+	double ppm = argc > 1 ? atof(argv[1]) : 1000;
+	long lines = argc > 2 ? atol(argv[2]) : 20000;
+	int handler = argc > 3 ? atoi(argv[3]) : 200;
+	double period = CYCLES_LINE + 1 + (CYCLES_LINE + 1) * ppm / 1e6;
+	long locked, slowest = 0;
+	int phase, worst, most = 0, failed = 0;
+	for(phase = 0; phase < CYCLES_LINE; phase += 7)
+	{
+		locked = run(period, phase + 0.5, lines, handler, &worst);
+		if(locked < 0)
+		{
+			++failed;
+			continue;
+		}
+
+		if(locked > slowest)
+		{
+			slowest = locked;
+		}
+
+		if(worst > most)
+		{
+			most = worst;
+		}
+	}
+
+	printf("period %.2f cycles (%+.0f ppm), handler %d cycles\n", period,
+		ppm, handler);
+	printf("not locked after %ld lines: %d of %d start phases\n", lines,
+		failed, (CYCLES_LINE + 6) / 7);
+	printf("locked after at most %ld lines, then within %d cycles\n",
+		slowest, most);
+	return failed != 0;
+}
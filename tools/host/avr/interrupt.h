@@ -0,0 +1,9 @@
+/* the host tests in tools/ run without interrupts */
+
+#ifndef __HOST_AVR_INTERRUPT_H__
+#define __HOST_AVR_INTERRUPT_H__
+
+#define sei()
+#define cli()
+
+#endif /* __HOST_AVR_INTERRUPT_H__ */
@@ -0,0 +1,18 @@
+/* the registers of the ATmega328P that mirror.c touches, as plain
+   variables for the host tests in tools/ */
+
+#ifndef __HOST_AVR_IO_H__
+#define __HOST_AVR_IO_H__
+
+#include <stdint.h>
+
+extern volatile uint8_t SREG, UCSR0A, UCSR0B, UCSR0C, UDR0;
+extern volatile uint16_t UBRR0;
+
+#define UCSZ00  1
+#define UCSZ01  2
+#define U2X0    1
+#define TXEN0   3
+#define UDRE0   5
+
+#endif /* __HOST_AVR_IO_H__ */
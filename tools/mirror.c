@@ -0,0 +1,258 @@
+/* host side of ENABLE_MIRROR: rebuilds the framebuffer from the serial
+   stream and writes it as a PBM (1bpp) or PGM (2bpp) image after every
+   frame marker.
+
+   cc -O2 -o mirror tools/mirror.c
+   ./mirror /dev/ttyUSB0 115200 screen.pbm
+   ./mirror - < capture.bin */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#define MIRROR_ROW    0xA5
+#define MIRROR_FRAME  0x5A
+
+static int in_fd;
+static uint8_t frame[256 * 256];
+static int width, height, bpp;
+
+static int next(void)
+{
+	static uint8_t buf[4096];
+	static ssize_t len, pos;
+	if(pos == len)
+	{
+		do
+		{
+			len = read(in_fd, buf, sizeof(buf));
+		}
+		while(len < 0 && errno == EINTR);
+		if(len <= 0)
+		{
+			return -1;
+		}
+
+		pos = 0;
+	}
+
+	return buf[pos++];
+}
+
+static speed_t baud(long rate)
+{
+	switch(rate)
+	{
+		case 9600:   return B9600;
+		case 19200:  return B19200;
+		case 38400:  return B38400;
+		case 57600:  return B57600;
+		case 230400: return B230400;
+		case 500000: return B500000;
+		case 1000000: return B1000000;
+		default:     return B115200;
+	}
+}
+
+static int open_input(const char *path, long rate)
+{
+	struct termios t;
+	int fd;
+	if(!strcmp(path, "-"))
+	{
+		return 0;
+	}
+
+	if((fd = open(path, O_RDONLY | O_NOCTTY)) < 0)
+	{
+		perror(path);
+		exit(1);
+	}
+
+	if(isatty(fd) && !tcgetattr(fd, &t))
+	{
+		cfmakeraw(&t);
+		cfsetispeed(&t, baud(rate));
+		cfsetospeed(&t, baud(rate));
+		t.c_cc[VMIN] = 1;
+		t.c_cc[VTIME] = 0;
+		tcsetattr(fd, TCSANOW, &t);
+	}
+
+	return fd;
+}
+
+/* a row record after MIRROR_ROW, copied into the frame only if its
+   checksum matches; returns -1 at the end of the input */
+static int read_row(void)
+{
+	uint8_t row[256], s1 = 0, s2 = 0;
+	int y, c, c2, b, n, i, pos = 0;
+	if((y = next()) < 0)
+	{
+		return -1;
+	}
+
+	while(pos < width)
+	{
+		if((c = next()) < 0)
+		{
+			return -1;
+		}
+
+		if(c < 128)
+		{
+			for(n = c + 1; n; --n)
+			{
+				if((b = next()) < 0)
+				{
+					return -1;
+				}
+
+				if(pos < width)
+				{
+					row[pos++] = b;
+				}
+			}
+		}
+		else if(c > 128)
+		{
+			if((b = next()) < 0)
+			{
+				return -1;
+			}
+
+			for(n = 257 - c; n && pos < width; --n)
+			{
+				row[pos++] = b;
+			}
+		}
+	}
+
+	if((c = next()) < 0 || (c2 = next()) < 0)
+	{
+		return -1;
+	}
+
+	for(i = 0; i < width; ++i)
+	{
+		s1 += row[i];
+		s2 += s1;
+	}
+
+	if(y < height && c == s1 && c2 == s2)
+	{
+		memcpy(frame + y * width, row, width);
+	}
+	else
+	{
+		fprintf(stderr, "mirror: bad row %d\n", y);
+	}
+
+	return 0;
+}
+
+/* pixels of the frame are 1 for white, PBM uses 1 for black */
+static void write_image(const char *path)
+{
+	char tmp[4096];
+	FILE *f;
+	int x, y, v;
+	snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+	if(!(f = fopen(tmp, "wb")))
+	{
+		perror(tmp);
+		return;
+	}
+
+	if(bpp == 2)
+	{
+		fprintf(f, "P5\n%d %d\n3\n", width * 4, height);
+		for(y = 0; y < height; ++y)
+		{
+			for(x = 0; x < width * 4; ++x)
+			{
+				v = frame[y * width + x / 4] >> (6 - 2 * (x & 3));
+				fputc(v & 3, f);
+			}
+		}
+	}
+	else
+	{
+		fprintf(f, "P4\n%d %d\n", width * 8, height);
+		for(y = 0; y < height * width; ++y)
+		{
+			fputc(~frame[y], f);
+		}
+	}
+
+	fclose(f);
+	rename(tmp, path);
+}
+
+int main(int argc, char **argv)
+{
+	const char *out = "mirror.pbm";
+	long rate = 115200;
+	int c, w, h, d, frames = 0;
+	if(argc < 2)
+	{
+		fprintf(stderr, "usage: %s device|- [baud] [image]\n", argv[0]);
+		return 1;
+	}
+
+	if(argc > 2)
+	{
+		rate = atol(argv[2]);
+	}
+
+	if(argc > 3)
+	{
+		out = argv[3];
+	}
+
+	in_fd = open_input(argv[1], rate);
+
+	/* rows are ignored until the first frame marker gives the size */
+	while((c = next()) >= 0)
+	{
+		if(c == MIRROR_ROW && width)
+		{
+			if(read_row() < 0)
+			{
+				break;
+			}
+		}
+		else if(c == MIRROR_FRAME)
+		{
+			if((w = next()) < 0 || (h = next()) < 0 || (d = next()) < 0)
+			{
+				break;
+			}
+
+			if(!w || !h || (d != 1 && d != 2))
+			{
+				continue;
+			}
+
+			if(w != width || h != height || d != bpp)
+			{
+				width = w;
+				height = h;
+				bpp = d;
+				memset(frame, 0, sizeof(frame));
+			}
+
+			write_image(out);
+			fprintf(stderr, "\rmirror: frame %d", ++frames);
+		}
+	}
+
+	fputc('\n', stderr);
+	return 0;
+}
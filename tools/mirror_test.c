@@ -0,0 +1,147 @@
+/* loopback test of ENABLE_MIRROR: runs the encoder of mirror.c on the
+   host, one call of mirror_line per scanline with a USART that is
+   always ready, while bytes of random rows keep changing. Then the
+   changes stop and the encoder finishes two more passes. The stream
+   goes to stdout and the frame as it ended to a PBM, which the decoder
+   has to write exactly, without a bad row. tools/mirror_test.sh runs
+   it with and without ENABLE_DIRTY.
+
+   cc -O2 -DF_CPU=16000000UL -DENABLE_MIRROR [-DENABLE_DIRTY] \
+      -Itools/host -I. -o mirror_test tools/mirror_test.c
+   ./mirror_test expect.pbm [frames] [seed] > stream.bin
+   ./mirror - 115200 got.pbm < stream.bin && cmp expect.pbm got.pbm */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../mirror.c"
+
+uint8_t frame[WIDTH * HEIGHT];
+volatile int scanLine;
+int stop_render;
+uint8_t start_render;
+
+volatile uint8_t SREG, UCSR0A, UCSR0B, UCSR0C, UDR0;
+volatile uint16_t UBRR0;
+
+#if defined(ENABLE_DIRTY)
+/* what video_dirty_mark does for the mirror */
+static void mark(uint8_t y)
+{
+	mirror_dirty[y >> 3] |= 0x80 >> (y & 7);
+}
+#else
+static void mark(uint8_t y)
+{
+	(void)y;
+}
+#endif
+
+/* a few bytes of a row, now and then the whole screen */
+static void edit(void)
+{
+	uint16_t i, n;
+	uint8_t y, x;
+	if(!(rand() % 200))
+	{
+		for(i = 0; i < WIDTH * HEIGHT; ++i)
+		{
+			frame[i] = rand();
+		}
+
+		for(y = 0; y < HEIGHT; ++y)
+		{
+			mark(y);
+		}
+
+		return;
+	}
+
+	y = rand() % HEIGHT;
+	x = rand() % WIDTH;
+	n = 1 + rand() % (WIDTH - x);
+	for(i = 0; i < n; ++i)
+	{
+		frame[y * WIDTH + x + i] = rand();
+	}
+
+	mark(y);
+}
+
+static void write_image(const char *path)
+{
+	FILE *f;
+	uint16_t i;
+	if(!(f = fopen(path, "wb")))
+	{
+		perror(path);
+		exit(1);
+	}
+
+	fprintf(f, "P4\n%d %d\n", WIDTH * 8, HEIGHT);
+	for(i = 0; i < WIDTH * HEIGHT; ++i)
+	{
+		fputc(~frame[i], f);
+	}
+
+	fclose(f);
+}
+
+int main(int argc, char **argv)
+{
+	long frames = argc > 2 ? atol(argv[2]) : 5000;
+	long line = 0;
+	int passes = -1, stop = -1;
+	uint8_t tail, last = MS_OFF;
+	if(argc < 2)
+	{
+		fprintf(stderr, "usage: %s expect.pbm [frames] [seed]\n", argv[0]);
+		return 1;
+	}
+
+	srand(argc > 3 ? atoi(argv[3]) : 1);
+	start_render = START_RENDER_NTSC;
+	stop_render = start_render + NTSC_LINE_DISPLAY;
+	mirror_begin();
+	UCSR0A |= 1 << UDRE0;
+	for(;; ++line)
+	{
+		scanLine = line % NTSC_LINE_FRAME;
+		tail = ms_tail;
+		mirror_line();
+		if(ms_tail != tail)
+		{
+			putchar(UDR0);
+		}
+
+		if(line < frames * NTSC_LINE_FRAME)
+		{
+			if(!(rand() % 40))
+			{
+				edit();
+			}
+		}
+		else if(passes < 0)
+		{
+			passes = 0;
+		}
+		else if(passes < 2 && ms_state == MS_WAIT && last != MS_WAIT)
+		{
+			++passes;
+		}
+		/* the frame marker after the second pass is in the ring */
+		else if(passes == 2 && stop < 0 && ms_state != MS_WAIT &&
+			ms_state != MS_MARK)
+		{
+			stop = ms_head;
+		}
+		else if(stop >= 0 && ms_tail == stop)
+		{
+			break;
+		}
+
+		last = ms_state;
+	}
+
+	write_image(argv[1]);
+	return 0;
+}
@@ -0,0 +1,25 @@
+#!/bin/sh
+# loopback test of ENABLE_MIRROR, see tools/mirror_test.c: encodes with
+# and without ENABLE_DIRTY for a few seeds and checks that tools/mirror.c
+# rebuilds the frame exactly
+cd "$(dirname "$0")/.." || exit 1
+t=${TMPDIR:-/tmp}/mirror_test.$$
+mkdir -p "$t" || exit 1
+trap 'rm -rf "$t"' EXIT
+cc -O2 -o "$t/mirror" tools/mirror.c || exit 1
+fail=0
+for d in "" -DENABLE_DIRTY; do
+	cc -O2 -DF_CPU=16000000UL -DENABLE_MIRROR $d -Itools/host -I. \
+		-o "$t/mirror_test" tools/mirror_test.c || exit 1
+	for seed in 1 2 3 4 5 6; do
+		"$t/mirror_test" "$t/expect.pbm" 5000 $seed > "$t/stream.bin"
+		"$t/mirror" - 115200 "$t/got.pbm" < "$t/stream.bin" 2> "$t/log"
+		if grep -q "bad row" "$t/log" ||
+			! cmp -s "$t/expect.pbm" "$t/got.pbm"; then
+			echo "mirror_test ${d:-checksum} seed $seed: FAIL"
+			fail=1
+		fi
+	done
+done
+[ $fail = 0 ] && echo "mirror_test: ok"
+exit $fail
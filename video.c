@@ -1,405 +1,2035 @@
 #include "video.h"
-
-extern const uint8_t font5x7[] PROGMEM;
+#if defined(ENABLE_SOUND)
+#include "sound.h"
+#endif
+#if defined(ENABLE_INPUT)
+#include "input.h"
+#endif
+#if defined(ENABLE_TERMINAL)
+#include "terminal.h"
+#endif
+#if defined(ENABLE_MIRROR)
+#include "mirror.h"
+#endif
 
 static void active_line(void);
 static void vsync_line(void);
+static void vsync_field(void);
 static void blank_line(void);
 
 volatile int scanLine;
-int renderLine, lines_frame;
+int renderLine, render_start, render_step, render_origin;
+int lines_frame, lines_end, stop_render;
 char vscale_const, vscale, vsync_end;
+uint8_t interlace, field, vhalf, vhalf_end, eq_pulses;
+uint16_t cycles_line, cycles_half, cycles_broad;
+#if defined(ENABLE_DISPLAY_LIST)
+#define SCAN_BUF dl_front
+#elif defined(ENABLE_SPIRAM)
+/* the pixel output reads SPDR instead of the buffer */
+#define SCAN_BUF 0
+#define TARGET_W PWIDTH
+#define TARGET_H HEIGHT
+#else
+#define SCAN_BUF frame
 uint8_t frame[WIDTH * HEIGHT];
+
+/* target of the drawing primitives, the screen or a surface */
+video_surface_t *draw_surface;
+uint8_t *draw_buf = frame, draw_width = WIDTH, draw_height = HEIGHT,
+	draw_pwidth = PWIDTH;
+#define TARGET_W draw_pwidth
+#define TARGET_H draw_height
+#endif
+
+#if !defined(ENABLE_DISPLAY_LIST)
+/* clip rectangle in target pixels, x1 and y1 exclusive, and the
+   drawing origin of the primitives */
+uint8_t clip_x0, clip_y0, clip_x1 = PWIDTH, clip_y1 = HEIGHT;
+int16_t draw_ox, draw_oy;
+#endif
+
+#if defined(ENABLE_DIRTY)
+static uint8_t dirty[DIRTY_BYTES];
+#endif
+
+#if defined(ENABLE_GENLOCK)
+#if defined(GENLOCK_ICP)
+#define GENLOCK_IN (!(ICP_IN & (1 << ICP_PIN)))
+#else
+#define GENLOCK_IN (ACSR & (1 << ACO))
+#endif
+
+/* period trim in 1/16 cycles, phase error of the last line, lines in
+   lock and lines that started inside a broad pulse. gl_top is the TOP
+   of the current line, OCR1A reads give the one of the next. */
+static int16_t gl_trim, gl_err;
+static uint8_t gl_lock, gl_broad;
+static uint16_t gl_top;
+#endif
+
+#if defined(ENABLE_SPIRAM)
+/* takes the byte of the running sequential read and starts the next
+   one, 2 cycles like LD. 8 pixels later the SPI has long finished. */
+#define PIX_LOAD \
+	"    in   __tmp_reg__, %[spdr] \n\t" \
+	"    out  %[spdr], __tmp_reg__ \n\t"
+#else
+#define PIX_LOAD \
+	"    LD   __tmp_reg__, X+      \n\t"
+#endif
+uint8_t vscale_sched[VSCALE_SCHED_SIZE], *vsched, vmask;
+#if defined(ENABLE_REGIONS)
+/* table being scanned out and the one latched at the next field,
+   position in the current band */
+static video_region_t regions[REGIONS], regions_new[REGIONS];
+static uint8_t region_n, region_n_new, region_new;
+static uint8_t region_i, region_left, region_sub, region_blank;
+#endif
 uint8_t start_render, output_delay, video_color = 0;
 void (*line_handler)(void);
 
+#if defined(ENABLE_GRAYSCALE)
+
+/* fill pattern for each color, INVERT is handled separately */
+static const uint8_t gray_fill[] = { 0x00, 0xFF, 0x00, 0x55, 0xAA };
+static const uint8_t gray_mask[] = { 0xC0, 0x30, 0x0C, 0x03 };
+
+#endif
+
 int16_t abs(int16_t v)
 {
 	return (v < 0) ? (v * -1) : v;
 }
 
+/* spread the rows of a field over the display lines, Bresenham style */
+static void video_vscale(int lines, uint8_t rows)
+{
+	uint8_t row, rem;
+	uint16_t err;
+	vscale_const = lines / rows - 1;
+	rem = lines % rows;
+	for(row = 0, err = rows / 2; row < rows; ++row)
+	{
+		if((err += rem) >= rows)
+		{
+			err -= rows;
+			vscale_sched[row >> 3] |= (0x80 >> (row & 7));
+		}
+		else
+		{
+			vscale_sched[row >> 3] &= ~(0x80 >> (row & 7));
+		}
+	}
+
+	stop_render = start_render + lines;
+}
+
+static inline void video_vscale_next(void)
+{
+	vscale = vscale_const;
+	if(*vsched & vmask)
+	{
+		++vscale;
+	}
+
+	if(!(vmask >>= 1))
+	{
+		vmask = 0x80;
+		++vsched;
+	}
+}
+
 void video_begin(uint8_t mode)
 {
+#if defined(ENABLE_GRAYSCALE)
+	VID_DDR |= (1 << VID_PIN) | (1 << (VID_PIN - 1));
+	VID_PORT &= ~((1 << VID_PIN) | (1 << (VID_PIN - 1)));
+#else
 	VID_DDR |= (1 << VID_PIN);
 	VID_PORT &= ~(1 << VID_PIN);
+#endif
+#if defined(ENABLE_SPIRAM)
+	video_spi_begin();
+#endif
+
+#if defined(ENABLE_GENLOCK)
+	/* fast PWM with TOP in OCR1A and OC1A off, the sync is captured
+	   into ICR1 after the noise canceler */
+	TCCR1A = (1 << WGM11) | (1 << WGM10);
+#if defined(GENLOCK_ICP)
+	TCCR1B = (1 << ICNC1) | (1 << WGM13) | (1 << WGM12) | (1 << CS10);
+#else
+	ADCSRA &= ~(1 << ADEN);
+	ADCSRB |= (1 << ACME);
+	ADMUX = GENLOCK_MUX;
+	ACSR = (1 << ACIC);
+	TCCR1B = (1 << ICNC1) | (1 << ICES1) | (1 << WGM13) | (1 << WGM12) |
+		(1 << CS10);
+#endif
+	mode &= ~INTERLACE;
+#else
 	SYNC_DDR |= (1 << SYNC_PIN);
 	SYNC_PORT |= (1 << SYNC_PIN);
-
 	TCCR1A = (1 << COM1A1) | (1 << COM1A0) | (1 << WGM11);
 	TCCR1B = (1 << WGM13) | (1 << WGM12) | (1 << CS10);
+#endif
 
-	if(mode)
+	interlace = mode & INTERLACE;
+	if(mode & PAL)
 	{
-		vscale_const = VSCALE_PAL;
 		start_render = START_RENDER_PAL;
+		video_vscale(PAL_LINE_DISPLAY, interlace ? HEIGHT / 2 : HEIGHT);
 		output_delay = PAL_CYCLES_OUTPUT_START;
 		vsync_end = PAL_LINE_STOP_VSYNC;
 		lines_frame = PAL_LINE_FRAME;
-		ICR1 = PAL_CYCLES_SCANLINE;
+		eq_pulses = PAL_EQ_PULSES;
+		cycles_line = PAL_CYCLES_SCANLINE;
+		cycles_half = PAL_CYCLES_HALFLINE;
+		cycles_broad = PAL_CYCLES_BROAD_SYNC;
 	}
 	else
 	{
-		vscale_const = VSCALE_NTSC;
 		start_render = START_RENDER_NTSC;
+		video_vscale(NTSC_LINE_DISPLAY, interlace ? HEIGHT / 2 : HEIGHT);
 		output_delay = NTSC_CYCLES_OUTPUT_START;
 		vsync_end = NTSC_LINE_STOP_VSYNC;
 		lines_frame = NTSC_LINE_FRAME;
-		ICR1 = NTSC_CYCLES_SCANLINE;
+		eq_pulses = NTSC_EQ_PULSES;
+		cycles_line = NTSC_CYCLES_SCANLINE;
+		cycles_half = NTSC_CYCLES_HALFLINE;
+		cycles_broad = NTSC_CYCLES_BROAD_SYNC;
 	}
 
-	vscale = vscale_const;
+#if defined(ENABLE_GENLOCK)
+	OCR1A = cycles_line;
+	gl_top = cycles_line;
+	TIFR1 = (1 << ICF1);
+#else
+	ICR1 = cycles_line;
 	OCR1A = CYCLES_HORZ_SYNC;
-	scanLine = lines_frame + 1;
-	line_handler = &vsync_line;
+#endif
+	if(interlace)
+	{
+		render_step = 2 * WIDTH;
+		vhalf = 0;
+		line_handler = &vsync_field;
+	}
+	else
+	{
+		render_start = 0;
+		render_step = WIDTH;
+		lines_end = lines_frame;
+		scanLine = lines_frame + 1;
+		line_handler = &vsync_line;
+	}
+
+#if defined(ENABLE_DISPLAY_LIST)
+	/* fire late in the back porch to leave the CPU to the renderer */
+	OCR1B = output_delay - DL_ISR_LEAD;
+	TIMSK1 = (1 << OCIE1B);
+#else
 	TIMSK1 = (1 << TOIE1);
+#endif
 	sei();
 }
 
-void video_sp(uint8_t x, uint8_t y)
+void video_set_color(uint8_t color)
 {
-	switch(video_color)
+	video_color = color;
+}
+
+/* glyph of c in the font header h copied out of flash, 0xFF if the
+   font does not have it */
+uint8_t video_font_glyph(const video_font_t *h, uint8_t c)
+{
+	if(c < h->first || c > h->last)
 	{
-		case 0:
+		return 0xFF;
+	}
+
+	return h->map ? pgm_read_byte(h->map + c - h->first) : c - h->first;
+}
+
+#if !defined(ENABLE_DISPLAY_LIST)
+
+/* frame row shown at the top of the screen, the rows above it wrap
+   around to the bottom. Scrolls without moving the framebuffer. */
+void video_set_origin(uint8_t y)
+{
+	int o = (y % HEIGHT) * WIDTH;
+	uint8_t sreg = SREG;
+	cli();
+	render_origin = o;
+	SREG = sreg;
+}
+
+#if defined(ENABLE_REGIONS)
+
+/* splits the screen into up to REGIONS bands from the top, rows below
+   the last one are blank. Shown from the next field on, n 0 goes back
+   to the single buffer of video_set_origin. */
+void video_set_regions(const video_region_t *r, uint8_t n)
+{
+	uint8_t i;
+	if(n > REGIONS)
+	{
+		n = REGIONS;
+	}
+
+	cli();
+	for(i = 0; i < n; ++i)
+	{
+		regions_new[i] = r[i];
+		regions_new[i].start %= HEIGHT;
+	}
+
+	region_n_new = n;
+	region_new = 1;
+	sei();
+}
+
+static void video_region_load(uint8_t i)
+{
+	region_i = i;
+	if(i >= region_n)
+	{
+		region_left = 0xFF;
+		region_blank = 1;
+		return;
+	}
+
+	region_left = regions[i].rows;
+	region_sub = 0;
+	region_blank = !regions[i].scale;
+	renderLine = regions[i].start * WIDTH;
+}
+
+/* n screen rows further down the table, a few cycles per frame row
+   and band crossed */
+static void video_region_step(uint8_t n)
+{
+	uint8_t scale;
+	while(n >= region_left)
+	{
+		n -= region_left;
+		video_region_load(region_i + 1);
+	}
+
+	region_left -= n;
+	if(region_blank)
+	{
+		return;
+	}
+
+	scale = regions[region_i].scale;
+	for(region_sub += n; region_sub >= scale; region_sub -= scale)
+	{
+		if((renderLine += WIDTH) >= WIDTH * HEIGHT)
 		{
-			frame[(x >> 3) + (y * WIDTH)] &= (~0x80 >> (x & 7));
-			break;
+			renderLine -= WIDTH * HEIGHT;
 		}
+	}
+}
 
-		case 1:
+/* from blank_line at the first active line, latches a new table */
+static void video_region_start(void)
+{
+	uint8_t i;
+	if(region_new)
+	{
+		for(i = 0; i < region_n_new; ++i)
 		{
-			frame[(x >> 3) + (y * WIDTH)] |= (0x80 >> (x & 7));
-			break;
+			regions[i] = regions_new[i];
 		}
 
-		case 2:
+		region_n = region_n_new;
+		region_new = 0;
+	}
+
+	region_blank = 0;
+	if(region_n)
+	{
+		video_region_load(0);
+		video_region_step(render_start ? 1 : 0);
+	}
+}
+
+static inline void video_region_next(void)
+{
+	if(region_n)
+	{
+		video_region_step(interlace ? 2 : 1);
+	}
+	else if((renderLine += render_step) >= WIDTH * HEIGHT)
+	{
+		renderLine -= WIDTH * HEIGHT;
+	}
+}
+
+#endif
+
+/* the clip rectangle is limited to the drawing target, so
+   (0, 0, 255, 255) draws on all of it again. x1 and y1 exclusive. */
+void video_set_clip(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+	if(x1 > TARGET_W) { x1 = TARGET_W; }
+	if(y1 > TARGET_H) { y1 = TARGET_H; }
+	if(x0 > x1) { x0 = x1; }
+	if(y0 > y1) { y0 = y1; }
+	clip_x0 = x0;
+	clip_y0 = y0;
+	clip_x1 = x1;
+	clip_y1 = y1;
+}
+
+/* added to the coordinates of every primitive */
+void video_set_draw_origin(int16_t x, int16_t y)
+{
+	draw_ox = x;
+	draw_oy = y;
+}
+
+uint8_t video_clip_code(int16_t x, int16_t y)
+{
+	uint8_t c = 0;
+	if(x < clip_x0) { c |= CLIP_LEFT; }
+	else if(x >= clip_x1) { c |= CLIP_RIGHT; }
+	if(y < clip_y0) { c |= CLIP_TOP; }
+	else if(y >= clip_y1) { c |= CLIP_BOTTOM; }
+	return c;
+}
+
+/* moves the bounding box of a primitive by the drawing origin and cuts
+   it to the clip rectangle, once per call. x1 and y1 exclusive. Tells
+   if the primitive can draw without checking its pixels. */
+uint8_t video_clip(int16_t *x0, int16_t *y0, int16_t *x1, int16_t *y1)
+{
+	uint8_t r = CLIP_IN;
+	*x0 += draw_ox;
+	*x1 += draw_ox;
+	*y0 += draw_oy;
+	*y1 += draw_oy;
+	if(*x0 < clip_x0) { *x0 = clip_x0; r = CLIP_PART; }
+	if(*y0 < clip_y0) { *y0 = clip_y0; r = CLIP_PART; }
+	if(*x1 > clip_x1) { *x1 = clip_x1; r = CLIP_PART; }
+	if(*y1 > clip_y1) { *y1 = clip_y1; r = CLIP_PART; }
+	if(*x0 >= *x1 || *y0 >= *y1)
+	{
+		return CLIP_OUT;
+	}
+
+#if defined(ENABLE_DIRTY)
+	video_dirty_clip(*y0, *y1);
+#endif
+	return r;
+}
+
+#if defined(ENABLE_DIRTY)
+
+static void dirty_set(uint8_t *d, uint8_t i, uint8_t j, uint8_t m0,
+	uint8_t m1)
+{
+	if(i == j)
+	{
+		d[i] |= m0 & m1;
+	}
+	else
+	{
+		d[i] |= m0;
+		while(++i < j)
 		{
-			frame[(x >> 3) + (y * WIDTH)] ^= (0x80 >> (x & 7));
-			break;
+			d[i] = 0xFF;
 		}
+
+		d[j] |= m1;
 	}
 }
 
-void video_set_color(uint8_t color)
+/* rows y0 to y1 - 1 of the framebuffer have changed, for code that
+   writes it directly. Whole bytes of the bitmap at once. The mirror
+   keeps its own bitmap of the rows it still has to send. */
+void video_dirty_mark(uint8_t y0, uint8_t y1)
 {
-	video_color = color;
+	uint8_t i, j, m0, m1, sreg;
+	if(y1 > HEIGHT)
+	{
+		y1 = HEIGHT;
+	}
+
+	if(y0 >= y1)
+	{
+		return;
+	}
+
+	i = y0 >> 3;
+	j = (y1 - 1) >> 3;
+	m0 = 0xFF >> (y0 & 7);
+	m1 = 0xFF << (7 - ((y1 - 1) & 7));
+
+	/* deferred commands mark from the line interrupt, callers may
+	   have interrupts off already */
+	sreg = SREG;
+	cli();
+	dirty_set(dirty, i, j, m0, m1);
+#if defined(ENABLE_MIRROR)
+	dirty_set(mirror_dirty, i, j, m0, m1);
+#endif
+	SREG = sreg;
 }
 
-void video_set_pixel(uint8_t x, uint8_t y)
+/* the rows of the drawing target a primitive may have changed, once
+   per call */
+void video_dirty_clip(int16_t y0, int16_t y1)
 {
-	if(x < PWIDTH && y < HEIGHT)
+#if !defined(ENABLE_SPIRAM)
+	if(draw_buf != frame)
 	{
-		video_sp(x, y);
+		return;
+	}
+#endif
+
+	if(y0 < clip_y0)
+	{
+		y0 = clip_y0;
+	}
+
+	if(y1 > clip_y1)
+	{
+		y1 = clip_y1;
+	}
+
+	if(y0 < y1)
+	{
+		video_dirty_mark(y0, y1);
 	}
 }
 
-uint8_t video_get_pixel(uint8_t x, uint8_t y)
+uint8_t video_dirty_row(uint8_t y)
 {
-	return(x < PWIDTH && y < HEIGHT &&
-			(frame[x / 8 + y * WIDTH] & (0x80 >> (x & 7))));
+	return y < HEIGHT && (dirty[y >> 3] & (0x80 >> (y & 7)));
 }
 
-void video_clear(void)
+/* copies the bitmap to rows (DIRTY_BYTES), if not 0, and clears it */
+void video_dirty_take(uint8_t *rows)
 {
-	uint16_t i;
-	uint8_t val;
-	switch(video_color)
+	uint8_t i, sreg = SREG;
+	cli();
+	for(i = 0; i < DIRTY_BYTES; ++i)
 	{
-		case BLACK:
+		if(rows)
 		{
-			val = 0x00;
-			break;
+			rows[i] = dirty[i];
 		}
 
-		case WHITE:
+		dirty[i] = 0;
+	}
+
+	SREG = sreg;
+}
+
+/* first row from y on that is set in rows, HEIGHT if there is none.
+   Skips 8 clean rows per byte. */
+uint8_t video_dirty_next(const uint8_t *rows, uint8_t y)
+{
+	uint8_t b;
+	while(y < HEIGHT)
+	{
+		b = rows[y >> 3] & (0xFF >> (y & 7));
+		if(!b)
 		{
-			val = 0xFF;
-			break;
+			y = (y | 7) + 1;
+			continue;
 		}
 
-		case INVERT:
+		for(y &= ~7; !(b & 0x80); b <<= 1)
 		{
-			for(i = 0; i < WIDTH * HEIGHT; ++i)
-			{
-				frame[i] = ~frame[i];
-			}
+			++y;
 		}
 
-		default:
+		return y < HEIGHT ? y : HEIGHT;
+	}
+
+	return HEIGHT;
+}
+
+#endif
+
+uint16_t video_text_width(const video_font_t *f, const char *s)
+{
+	video_font_t h;
+	uint16_t w = 0;
+	uint8_t g;
+	memcpy_P(&h, f, sizeof(h));
+	for(; *s; ++s)
+	{
+		if((g = video_font_glyph(&h, *s)) != 0xFF)
 		{
-			return;
+			w += pgm_read_byte(h.width + g);
 		}
 	}
 
-	for(i = 0; i < WIDTH * HEIGHT; ++i)
+	return w;
+}
+
+/* characters that cross the clip rectangle are drawn in part */
+void video_char(uint8_t x, uint8_t y, char c)
+{
+	char s[2];
+	s[0] = c;
+	s[1] = 0;
+	video_text(&font5x7, x, y, s);
+}
+
+void video_string(uint8_t x, uint8_t y, char *s)
+{
+	video_text(&font5x7, x, y, s);
+}
+
+#if !defined(ENABLE_SPIRAM)
+
+/* the primitives draw into s from now on, 0 selects the screen. The
+   clip rectangle is reset to the whole target and the drawing origin
+   to 0, 0. */
+void video_set_surface(video_surface_t *s)
+{
+	draw_surface = s;
+	if(s)
+	{
+		draw_buf = s->data;
+		draw_width = s->width;
+		draw_height = s->height;
+	}
+	else
 	{
-		frame[i] = val;
+		draw_buf = frame;
+		draw_width = WIDTH;
+		draw_height = HEIGHT;
 	}
+
+	/* pixels past x 254 cannot be addressed, nor counted in draw_pwidth */
+	draw_pwidth = draw_width > 255 / (8 / BPP) ? 255 :
+		draw_width * (8 / BPP);
+	video_set_clip(0, 0, 255, 255);
+	video_set_draw_origin(0, 0);
 }
 
-void video_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+video_surface_t *video_get_surface(void)
+{
+	return draw_surface;
+}
+
+/* the top pixel of a byte */
+#define PIX_MASK ((0xFF << (8 - BPP)) & 0xFF)
+
+/* pixels of a surface that are partly clipped are copied one by one */
+static void video_blit_clipped(const video_surface_t *s, int16_t x,
+	int16_t y, int16_t x0, int16_t y0, int16_t x1, int16_t y1)
 {
-	uint8_t ox = x0;
-	if(x0 >= PWIDTH) { x0 = PWIDTH - 1; }
-	if(y0 >= HEIGHT) { y0 = HEIGHT - 1; }
-	if(x1 >= PWIDTH) { x1 = PWIDTH - 1; }
-	if(y1 >= HEIGHT) { y1 = HEIGHT - 1; }
-	while(y0 < y1)
+	uint8_t *d, b, sh;
+	const uint8_t *p;
+	uint16_t sx;
+	int16_t px;
+	for(; y0 < y1; ++y0)
 	{
-		while(x0 < x1)
+		p = s->data + (y0 - y) * s->width;
+		d = draw_buf + y0 * draw_width;
+		for(px = x0; px < x1; ++px)
 		{
-			video_sp(x0, y0);
-			++x0;
+			sx = (px - x) * BPP;
+			b = (p[sx >> 3] << (sx & 7)) & PIX_MASK;
+			sh = (px * BPP) & 7;
+			d[(px * BPP) >> 3] = (d[(px * BPP) >> 3] & ~(PIX_MASK >> sh)) |
+				(b >> sh);
 		}
-
-		x0 = ox;
-		++y0;
 	}
-
-	frame[0] = 0xFF;
 }
 
-void video_circle(int16_t x0, int16_t y0, int16_t radius)
+/* copies s to x, y of the drawing target. Whole bytes are copied when
+   x is byte aligned, otherwise every byte is split over two and the
+   pixels next to the edges are kept. s must not overlap the target. */
+void video_blit(const video_surface_t *s, uint8_t x, uint8_t y)
 {
-	int16_t x = radius - 1, y = 0, dx = 1, dy = 1,
-	err = dx - (radius << 1);
-	while(x >= y)
+	uint8_t *d, r, i, sh, lm, c;
+	const uint8_t *p;
+	int16_t x0 = x, y0 = y, x1, y1;
+	x1 = x0 + s->width * (8 / BPP);
+	y1 = y0 + s->height;
+	if(!(c = video_clip(&x0, &y0, &x1, &y1)))
 	{
-		video_set_pixel(x0 + x, y0 + y);
-		video_set_pixel(x0 + y, y0 + x);
-		video_set_pixel(x0 - y, y0 + x);
-		video_set_pixel(x0 - x, y0 + y);
-		video_set_pixel(x0 - x, y0 - y);
-		video_set_pixel(x0 - y, y0 - x);
-		video_set_pixel(x0 + y, y0 - x);
-		video_set_pixel(x0 + x, y0 - y);
+		return;
+	}
 
-		if(err <= 0)
+	if(c == CLIP_PART)
+	{
+		video_blit_clipped(s, x + draw_ox, y + draw_oy, x0, y0, x1, y1);
+		return;
+	}
+
+	sh = (x0 * BPP) & 7;
+	lm = 0xFF >> sh;
+	for(r = 0, p = s->data; r < s->height; ++r, p += s->width)
+	{
+		d = draw_buf + (y0 + r) * draw_width + ((x0 * BPP) >> 3);
+		if(!sh)
 		{
-			++y;
-			err += dy;
-			dy += 2;
+			for(i = 0; i < s->width; ++i)
+			{
+				d[i] = p[i];
+			}
+
+			continue;
 		}
 
-		if(err > 0)
+		/* the pixels end inside byte width, it is always there */
+		d[0] = (d[0] & ~lm) | (p[0] >> sh);
+		for(i = 1; i < s->width; ++i)
 		{
-			--x;
-			dx += 2;
-			err += dx - (radius << 1);
+			d[i] = (p[i - 1] << (8 - sh)) | (p[i] >> sh);
 		}
+
+		d[i] = (d[i] & lm) | (p[i - 1] << (8 - sh));
 	}
 }
 
-void video_hline(uint8_t x, uint8_t y, uint8_t l)
+/* 8 rows of the pattern of the filled primitives, 0 fills solid */
+static const uint8_t *pattern;
+
+#if defined(ENABLE_GRAYSCALE)
+
+void video_sp(uint8_t x, uint8_t y)
 {
-	uint8_t e;
-	if(x < PWIDTH && y < HEIGHT && (e = x + l) < PWIDTH)
+	uint8_t *p, m;
+	p = &draw_buf[(x >> 2) + (y * draw_width)];
+	m = gray_mask[x & 3];
+	if(video_color == INVERT)
 	{
-		for(; x < e; ++x)
-		{
-			video_sp(x, y);
-		}
+		*p ^= m;
+	}
+	else
+	{
+		*p = (*p & ~m) | (gray_fill[video_color] & m);
 	}
 }
 
-void video_vline(uint8_t x, uint8_t y, uint8_t l)
+/* x0 to x1 inclusive on row y, unchecked */
+static void video_span(uint8_t x0, uint8_t x1, uint8_t y)
 {
-	uint8_t e;
-	if(x < PWIDTH && y < HEIGHT && (e = y + l) < HEIGHT)
+	for(; x0 <= x1; ++x0)
 	{
-		for(; y < e; ++y)
-		{
-			video_sp(x, y);
-		}
+		video_sp(x0, y);
 	}
 }
 
-void video_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+#else
+
+void video_sp(uint8_t x, uint8_t y)
 {
-	int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
-	int16_t dy = abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
-	int16_t err = (dx > dy ? dx : -dy) / 2, e2;
-	while(x0 != x1 && y0 != y1)
+	switch(video_color)
 	{
-		video_set_pixel(x0, y0);
-
-		e2 = err;
+		case 0:
+		{
+			draw_buf[(x >> 3) + (y * draw_width)] &= (~0x80 >> (x & 7));
+			break;
+		}
 
-		if(e2 > -dx)
+		case 1:
 		{
-			err -= dy;
-			x0 += sx;
+			draw_buf[(x >> 3) + (y * draw_width)] |= (0x80 >> (x & 7));
+			break;
 		}
 
-		if(e2 < dy)
+		case 2:
 		{
-			err += dx;
-			y0 += sy;
+			draw_buf[(x >> 3) + (y * draw_width)] ^= (0x80 >> (x & 7));
+			break;
 		}
 	}
 }
 
-void video_char(uint8_t x, uint8_t y, char c)
+/* ordered dither thresholds */
+static const uint8_t bayer[64] PROGMEM =
+{
+	 0, 32,  8, 40,  2, 34, 10, 42,
+	48, 16, 56, 24, 50, 18, 58, 26,
+	12, 44,  4, 36, 14, 46,  6, 38,
+	60, 28, 52, 20, 62, 30, 54, 22,
+	 3, 35, 11, 43,  1, 33,  9, 41,
+	51, 19, 59, 27, 49, 17, 57, 25,
+	15, 47,  7, 39, 13, 45,  5, 37,
+	63, 31, 55, 23, 61, 29, 53, 21
+};
+
+static uint8_t dither[8];
+
+/* 8 rows of 8 pixels, MSB left, repeated from the top left corner of
+   the target. Set pixels take the color and clear ones the opposite,
+   INVERT only inverts the set ones. 0 goes back to solid fills. */
+void video_set_pattern(const uint8_t *p)
+{
+	pattern = p;
+}
+
+const uint8_t *video_get_pattern(void)
+{
+	return pattern;
+}
+
+/* level 0 is black and 64 white, the steps between spread the pixels
+   as evenly as an 8x8 Bayer matrix allows */
+void video_set_dither(uint8_t level)
+{
+	uint8_t y, x, b;
+	const uint8_t *t = bayer;
+	for(y = 0; y < 8; ++y)
+	{
+		for(x = 0, b = 0; x < 8; ++x, ++t)
+		{
+			b <<= 1;
+			if(pgm_read_byte(t) < level)
+			{
+				b |= 1;
+			}
+		}
+
+		dither[y] = b;
+	}
+
+	pattern = dither;
+}
+
+/* pat is the pattern row, 0xFF for a solid fill */
+static void video_mask(uint8_t *p, uint8_t m, uint8_t pat)
+{
+	switch(video_color)
+	{
+		case BLACK:
+		{
+			*p = (*p & ~m) | (~pat & m);
+			break;
+		}
+
+		case WHITE:
+		{
+			*p = (*p & ~m) | (pat & m);
+			break;
+		}
+
+		case INVERT:
+		{
+			*p ^= m & pat;
+			break;
+		}
+	}
+}
+
+/* x0 to x1 inclusive on row y, unchecked, whole bytes at once with
+   the row of the pattern as mask */
+static void video_span(uint8_t x0, uint8_t x1, uint8_t y)
+{
+	uint8_t *p, *e, pat;
+	pat = pattern ? pattern[y & 7] : 0xFF;
+	p = draw_buf + y * draw_width;
+	e = p + (x1 >> 3);
+	p += x0 >> 3;
+	if(p == e)
+	{
+		video_mask(p, (0xFF >> (x0 & 7)) & (0xFF << (7 - (x1 & 7))), pat);
+		return;
+	}
+
+	video_mask(p, 0xFF >> (x0 & 7), pat);
+	for(++p; p < e; ++p)
+	{
+		video_mask(p, 0xFF, pat);
+	}
+
+	video_mask(e, 0xFF << (7 - (x1 & 7)), pat);
+}
+
+#endif
+
+/* plots x, y of the target, checking it only if the primitive was not
+   found to be fully inside the clip rectangle */
+static inline void video_clip_sp(uint8_t c, int16_t x, int16_t y)
+{
+	if(c == CLIP_IN || !video_clip_code(x, y))
+	{
+		video_sp(x, y);
+	}
+}
+
+void video_set_pixel(uint8_t x, uint8_t y)
+{
+	video_clip_sp(CLIP_PART, x + draw_ox, y + draw_oy);
+#if defined(ENABLE_DIRTY)
+	video_dirty_clip(y + draw_oy, y + draw_oy + 1);
+#endif
+}
+
+#if defined(ENABLE_GRAYSCALE)
+
+/* returns the gray level 0 - 3 */
+uint8_t video_get_pixel(uint8_t x, uint8_t y)
+{
+	int16_t ax = x + draw_ox, ay = y + draw_oy;
+	if(!video_clip_code(ax, ay))
+	{
+		return (draw_buf[ax / 4 + ay * draw_width] >>
+			(6 - ((ax & 3) << 1))) & 3;
+	}
+
+	return 0;
+}
+
+#else
+
+uint8_t video_get_pixel(uint8_t x, uint8_t y)
+{
+	int16_t ax = x + draw_ox, ay = y + draw_oy;
+	return(!video_clip_code(ax, ay) &&
+			(draw_buf[ax / 8 + ay * draw_width] & (0x80 >> (ax & 7))));
+}
+
+#endif
+
+/* fills the clip rectangle, the whole buffer at once if it is not
+   clipped and there is no pattern */
+void video_clear(void)
+{
+	uint16_t i;
+	uint8_t val, y;
+#if defined(ENABLE_DIRTY)
+	video_dirty_clip(clip_y0, clip_y1);
+#endif
+	if(pattern || clip_x0 || clip_y0 || clip_x1 < draw_pwidth ||
+		clip_y1 < draw_height)
+	{
+		for(y = clip_y0; clip_x0 < clip_x1 && y < clip_y1; ++y)
+		{
+			video_span(clip_x0, clip_x1 - 1, y);
+		}
+
+		return;
+	}
+
+	switch(video_color)
+	{
+		case BLACK:
+		{
+			val = 0x00;
+			break;
+		}
+
+		case WHITE:
+		{
+			val = 0xFF;
+			break;
+		}
+
+#if defined(ENABLE_GRAYSCALE)
+		case DARK_GRAY:
+		case LIGHT_GRAY:
+		{
+			val = gray_fill[video_color];
+			break;
+		}
+#endif
+
+		case INVERT:
+		{
+			for(i = 0; i < draw_width * draw_height; ++i)
+			{
+				draw_buf[i] = ~draw_buf[i];
+			}
+		}
+
+		default:
+		{
+			return;
+		}
+	}
+
+	for(i = 0; i < draw_width * draw_height; ++i)
+	{
+		draw_buf[i] = val;
+	}
+}
+
+/* x1 and y1 exclusive */
+void video_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+	int16_t ax0 = x0, ay0 = y0, ax1 = x1, ay1 = y1;
+	if(!video_clip(&ax0, &ay0, &ax1, &ay1))
+	{
+		return;
+	}
+
+	for(; ay0 < ay1; ++ay0)
+	{
+		video_span(ax0, ax1 - 1, ay0);
+	}
+}
+
+void video_circle(int16_t x0, int16_t y0, int16_t radius)
+{
+	int16_t x = radius - 1, y = 0, dx = 1, dy = 1,
+	err = dx - (radius << 1);
+	int16_t bx0 = x0 - radius, by0 = y0 - radius,
+	bx1 = x0 + radius + 1, by1 = y0 + radius + 1;
+	uint8_t c;
+	if(!(c = video_clip(&bx0, &by0, &bx1, &by1)))
+	{
+		return;
+	}
+
+	x0 += draw_ox;
+	y0 += draw_oy;
+	while(x >= y)
+	{
+		video_clip_sp(c, x0 + x, y0 + y);
+		video_clip_sp(c, x0 + y, y0 + x);
+		video_clip_sp(c, x0 - y, y0 + x);
+		video_clip_sp(c, x0 - x, y0 + y);
+		video_clip_sp(c, x0 - x, y0 - y);
+		video_clip_sp(c, x0 - y, y0 - x);
+		video_clip_sp(c, x0 + y, y0 - x);
+		video_clip_sp(c, x0 + x, y0 - y);
+
+		if(err <= 0)
+		{
+			++y;
+			err += dy;
+			dy += 2;
+		}
+
+		if(err > 0)
+		{
+			--x;
+			dx += 2;
+			err += dx - (radius << 1);
+		}
+	}
+}
+
+void video_hline(uint8_t x, uint8_t y, uint8_t l)
+{
+	int16_t x0 = x, y0 = y, x1 = x + l, y1 = y + 1;
+	if(video_clip(&x0, &y0, &x1, &y1))
+	{
+		video_span(x0, x1 - 1, y0);
+	}
+}
+
+void video_vline(uint8_t x, uint8_t y, uint8_t l)
+{
+	int16_t x0 = x, y0 = y, x1 = x + 1, y1 = y + l;
+	if(video_clip(&x0, &y0, &x1, &y1))
+	{
+		for(; y0 < y1; ++y0)
+		{
+			video_sp(x0, y0);
+		}
+	}
+}
+
+#if !defined(ENABLE_GRAYSCALE)
+
+/* both end points inside the clip rectangle, steps a pointer and a
+   bit mask through the buffer instead of addressing every pixel */
+static void video_line_fast(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+	uint8_t *p, m, op, n;
+	int16_t dx, dy, err, e2;
+	int8_t sx;
+	int16_t sy;
+	dx = abs(x1 - x0);
+	dy = abs(y1 - y0);
+	sx = x0 < x1 ? 1 : -1;
+	sy = y0 < y1 ? draw_width : -draw_width;
+	err = (dx > dy ? dx : -dy) / 2;
+	n = (dx > dy ? dx : dy) + 1;
+	p = draw_buf + y0 * draw_width + (x0 >> 3);
+	m = 0x80 >> (x0 & 7);
+	op = video_color;
+	while(n--)
+	{
+		if(op == WHITE)
+		{
+			*p |= m;
+		}
+		else if(op == BLACK)
+		{
+			*p &= ~m;
+		}
+		else
+		{
+			*p ^= m;
+		}
+
+		e2 = err;
+		if(e2 > -dx)
+		{
+			err -= dy;
+			if(sx > 0)
+			{
+				if(!(m >>= 1))
+				{
+					m = 0x80;
+					++p;
+				}
+			}
+			else if(!(m <<= 1))
+			{
+				m = 0x01;
+				--p;
+			}
+		}
+
+		if(e2 < dy)
+		{
+			err += dx;
+			p += sy;
+		}
+	}
+}
+
+#endif
+
+/* lines with both ends in the clip rectangle are drawn unchecked and
+   those with both beyond the same edge not at all */
+void video_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+	int16_t dx, dy, sx, sy, err, e2;
+	uint8_t ca, cb, c;
+	x0 += draw_ox;
+	y0 += draw_oy;
+	x1 += draw_ox;
+	y1 += draw_oy;
+	ca = video_clip_code(x0, y0);
+	cb = video_clip_code(x1, y1);
+	if(ca & cb)
+	{
+		return;
+	}
+
+#if defined(ENABLE_DIRTY)
+	video_dirty_clip(y0 < y1 ? y0 : y1, (y0 < y1 ? y1 : y0) + 1);
+#endif
+	c = (ca | cb) ? CLIP_PART : CLIP_IN;
+#if !defined(ENABLE_GRAYSCALE)
+	if(c == CLIP_IN)
+	{
+		video_line_fast(x0, y0, x1, y1);
+		return;
+	}
+#endif
+
+	dx = abs(x1 - x0);
+	sx = x0 < x1 ? 1 : -1;
+	dy = abs(y1 - y0);
+	sy = y0 < y1 ? 1 : -1;
+	err = (dx > dy ? dx : -dy) / 2;
+	for(;;)
+	{
+		video_clip_sp(c, x0, y0);
+		if(x0 == x1 && y0 == y1)
+		{
+			break;
+		}
+
+		e2 = err;
+
+		if(e2 > -dx)
+		{
+			err -= dy;
+			x0 += sx;
+		}
+
+		if(e2 < dy)
+		{
+			err += dx;
+			y0 += sy;
+		}
+	}
+}
+
+/* one glyph at x, y of the target, rows of (w + 7) / 8 bytes. Inside
+   the clip every byte is merged with two masks, otherwise the pixels
+   are checked. */
+static void video_glyph(const uint8_t *g, uint8_t w, uint8_t h,
+	int16_t x, int16_t y, uint8_t c)
+{
+	uint8_t r, i, n;
+	n = (w + 7) >> 3;
+#if !defined(ENABLE_GRAYSCALE)
+	if(c == CLIP_IN)
+	{
+		uint8_t b, sh = x & 7, *d;
+		for(r = 0; r < h; ++r)
+		{
+			d = draw_buf + (y + r) * draw_width + (x >> 3);
+			for(i = 0; i < n; ++i, ++g, ++d)
+			{
+				/* the bits past w are clear, the second byte is only
+				   touched if pixels of the glyph land in it */
+				if((b = pgm_read_byte(g)))
+				{
+					video_mask(d, b >> sh, 0xFF);
+					if(sh && (uint8_t)(b << (8 - sh)))
+					{
+						video_mask(d + 1, b << (8 - sh), 0xFF);
+					}
+				}
+			}
+		}
+
+		return;
+	}
+#endif
+
+	for(r = 0; r < h; ++r, g += n)
+	{
+		for(i = 0; i < w; ++i)
+		{
+			if(pgm_read_byte(g + (i >> 3)) & (0x80 >> (i & 7)))
+			{
+				video_clip_sp(c, x + i, y + r);
+			}
+		}
+	}
+}
+
+/* s in a font made by tools/fontc, each glyph is clipped on its own.
+   The set pixels take the color, the others are left alone. Returns
+   the width of the text. */
+uint16_t video_text(const video_font_t *f, uint8_t x, uint8_t y,
+	const char *s)
+{
+	video_font_t h;
+	uint8_t g, w, c;
+	int16_t ax = x, x0, y0, x1, y1;
+	memcpy_P(&h, f, sizeof(h));
+	for(; *s; ++s)
+	{
+		if((g = video_font_glyph(&h, *s)) == 0xFF)
+		{
+			continue;
+		}
+
+		w = pgm_read_byte(h.width + g);
+		x0 = ax;
+		y0 = y;
+		x1 = ax + w;
+		y1 = y + h.height;
+		if((c = video_clip(&x0, &y0, &x1, &y1)))
+		{
+			video_glyph(h.bitmap + pgm_read_word(h.offset + g), w,
+				h.height, ax + draw_ox, y + draw_oy, c);
+		}
+
+		ax += w;
+	}
+
+	return ax - x;
+}
+
+/* 7 pixels per byte, rows of x1 - x0 pixels */
+void video_bitmap
+(uint8_t *img, uint8_t x0, uint8_t y0, uint8_t x1, uint16_t len)
+{
+	uint8_t *end, mask, c;
+	int16_t ax, ay, sx, ex, bx0 = x0, by0 = y0, bx1 = x1, by1;
+	uint32_t n;
+	if(x1 <= x0)
+	{
+		return;
+	}
+
+	n = ((uint32_t)len * 7 + (x1 - x0) - 1) / (x1 - x0);
+	by1 = y0 + (n < 0x4000 ? n : 0x4000);
+	if(!(c = video_clip(&bx0, &by0, &bx1, &by1)))
+	{
+		return;
+	}
+
+	sx = ax = x0 + draw_ox;
+	ex = x1 + draw_ox;
+	ay = y0 + draw_oy;
+	for(end = img + len; img < end; ++img)
+	{
+		for(mask = 1; mask < 0x80; mask <<= 1)
+		{
+			if(*img & mask)
+			{
+				video_clip_sp(c, ax, ay);
+			}
+
+			if(++ax == ex)
+			{
+				ax = sx;
+				++ay;
+			}
+		}
+	}
+}
+
+/* span from x0 to x1 exclusive on row y of the target, cut to the clip
+   rectangle unless the primitive is fully inside */
+static void video_clip_span(uint8_t c, int16_t x0, int16_t x1, int16_t y)
+{
+	if(c == CLIP_PART)
+	{
+		if(y < clip_y0 || y >= clip_y1)
+		{
+			return;
+		}
+
+		if(x0 < clip_x0) { x0 = clip_x0; }
+		if(x1 > clip_x1) { x1 = clip_x1; }
+	}
+
+	if(x0 < x1)
+	{
+		video_span(x0, x1 - 1, y);
+	}
+}
+
+/* a disc of pixels within radius of the center, every row is filled
+   once so INVERT and patterns work */
+void video_fill_circle(int16_t x0, int16_t y0, int16_t radius)
+{
+	int16_t x, y, bx0 = x0 - radius, by0 = y0 - radius,
+	bx1 = x0 + radius + 1, by1 = y0 + radius + 1;
+	uint32_t rr;
+	uint8_t c;
+	if(radius < 0 || !(c = video_clip(&bx0, &by0, &bx1, &by1)))
+	{
+		return;
+	}
+
+	x0 += draw_ox;
+	y0 += draw_oy;
+	rr = (uint32_t)radius * radius + radius;
+	video_clip_span(c, x0 - radius, x0 + radius + 1, y0);
+	for(y = 1, x = radius; y <= radius; ++y)
+	{
+		while((uint32_t)x * x + (uint32_t)y * y > rr)
+		{
+			--x;
+		}
+
+		video_clip_span(c, x0 - x, x0 + x + 1, y0 - y);
+		video_clip_span(c, x0 - x, x0 + x + 1, y0 + y);
+	}
+}
+
+typedef struct
+{
+	int16_t y0, y1;
+	int32_t x, dx;
+} poly_edge_t;
+
+/* n vertices as x, y pairs between -16384 and 16383, even-odd rule.
+   The right and bottom edges stay open like those of video_rect. One
+   division per edge, then every row steps the edges and fills between
+   pairs of crossings. Returns 0 if n is not between 3 and
+   POLY_VERTICES. */
+uint8_t video_fill_polygon(const int16_t *xy, uint8_t n)
+{
+	poly_edge_t e[POLY_VERTICES], *p;
+	int16_t xs[POLY_VERTICES], xa, ya, xb, yb, t, y;
+	int16_t bx0 = 0x7FFF, by0 = 0x7FFF, bx1 = -0x8000, by1 = -0x8000;
+	uint8_t i, j, k, ne, c;
+	if(n < 3 || n > POLY_VERTICES)
+	{
+		return 0;
+	}
+
+	for(i = 0; i < n; ++i)
+	{
+		if(xy[2 * i] < bx0) { bx0 = xy[2 * i]; }
+		if(xy[2 * i] >= bx1) { bx1 = xy[2 * i] + 1; }
+		if(xy[2 * i + 1] < by0) { by0 = xy[2 * i + 1]; }
+		if(xy[2 * i + 1] >= by1) { by1 = xy[2 * i + 1] + 1; }
+	}
+
+	if(!(c = video_clip(&bx0, &by0, &bx1, &by1)))
+	{
+		return 1;
+	}
+
+	for(i = 0, ne = 0, p = e; i < n; ++i)
+	{
+		j = (i + 1 < n) ? i + 1 : 0;
+		xa = xy[2 * i] + draw_ox;
+		ya = xy[2 * i + 1] + draw_oy;
+		xb = xy[2 * j] + draw_ox;
+		yb = xy[2 * j + 1] + draw_oy;
+		if(ya == yb)
+		{
+			continue;
+		}
+
+		if(ya > yb)
+		{
+			t = xa; xa = xb; xb = t;
+			t = ya; ya = yb; yb = t;
+		}
+
+		if(yb <= by0 || ya >= by1)
+		{
+			continue;
+		}
+
+		p->dx = ((int32_t)(xb - xa) << 16) / (yb - ya);
+		p->x = ((int32_t)xa << 16) + 0x8000;
+		if(ya < by0)
+		{
+			p->x += p->dx * (by0 - ya);
+			ya = by0;
+		}
+
+		p->y0 = ya;
+		p->y1 = yb;
+		++p;
+		++ne;
+	}
+
+	for(y = by0; y < by1; ++y)
+	{
+		for(i = 0, k = 0, p = e; i < ne; ++i, ++p)
+		{
+			if(y >= p->y0 && y < p->y1)
+			{
+				t = p->x >> 16;
+				for(j = k++; j && xs[j - 1] > t; --j)
+				{
+					xs[j] = xs[j - 1];
+				}
+
+				xs[j] = t;
+				p->x += p->dx;
+			}
+		}
+
+		for(i = 0; i + 1 < k; i += 2)
+		{
+			video_clip_span(c, xs[i], xs[i + 1], y);
+		}
+	}
+
+	return 1;
+}
+
+void video_shift(uint8_t distance, uint8_t dir)
+{
+#if defined(ENABLE_DIRTY)
+	if(draw_buf == frame)
+	{
+		video_dirty_mark(0, HEIGHT);
+	}
+#endif
+	switch(dir)
+	{
+		case UP:
+		{
+			uint8_t *src, *dst, *end;
+			dst = draw_buf;
+			src = draw_buf + distance * draw_width;
+			end = draw_buf + draw_height * draw_width;
+			while(src < end)
+			{
+				*dst = *src;
+				*src = 0;
+				++dst;
+				++src;
+			}
+			break;
+		}
+
+		case DOWN:
+		{
+			uint8_t *src, *dst, *end;
+			dst = draw_buf + draw_height * draw_width - 1;
+			src = dst - distance * draw_width;
+			end = draw_buf;
+			while(src >= end)
+			{
+				*dst = *src;
+				*src = 0;
+				--dst;
+				--src;
+			}
+			break;
+		}
+
+		case LEFT:
+		{
+			uint8_t *src, *dst, *end, shift, tmp, line;
+			distance *= BPP;
+			shift = distance & 7;
+			for(line = 0; line < draw_height; ++line)
+			{
+				dst = draw_buf + draw_width * line;
+				src = dst + distance / 8;
+				end = dst + draw_width - 2;
+				while(src <= end)
+				{
+					tmp = 0;
+					tmp = *src << shift;
+					*src = 0;
+					++src;
+					tmp |= *src >> (8 - shift);
+					*dst = tmp;
+					++dst;
+				}
+
+				tmp = 0;
+				tmp = *src << shift;
+				*src = 0;
+				*dst = tmp;
+			}
+			break;
+		}
+
+		case RIGHT:
+		{
+			uint8_t *src, *dst, *end, shift, tmp, line;
+			distance *= BPP;
+			shift = distance & 7;
+			for(line = 0; line < draw_height; ++line)
+			{
+				dst = draw_buf + draw_width - 1 + draw_width * line;
+				src = dst - distance / 8;
+				end = dst - draw_width + 2;
+				while(src >= end)
+				{
+					tmp = 0;
+					tmp = *src >> shift;
+					*src = 0;
+					--src;
+					tmp |= *src << (8 - shift);
+					*dst = tmp;
+					--dst;
+				}
+
+				tmp = 0;
+				tmp = *src >> shift;
+				*src = 0;
+				*dst = tmp;
+			}
+			break;
+		}
+	}
+}
+
+#if !defined(ENABLE_GRAYSCALE)
+
+typedef struct
+{
+	uint8_t y, l, r;
+	int8_t dy;
+} fill_span_t;
+
+/* spans of video_fill still to be scanned on row y + dy */
+static fill_span_t fill_stack[FILL_STACK];
+static uint8_t fill_n;
+
+/* the 8 neighbours of a pixel in order around it as x, y pairs, the
+   even ones are the 4 neighbours and the directions of fill_step */
+static const int8_t fill_ring[16] PROGMEM =
+{
+	1, 0, 1, 1, 0, 1, -1, 1, -1, 0, -1, -1, 0, -1, 1, -1
+};
+
+#define FILL_DX(i) ((int8_t)pgm_read_byte(fill_ring + 2 * (i)))
+#define FILL_DY(i) ((int8_t)pgm_read_byte(fill_ring + 2 * (i) + 1))
+
+/* pixel x of a row belongs to the area, tb is a byte of its value */
+#define FILL_TEST(row, x) \
+	(!((((row)[(x) >> 3] << ((x) & 7)) ^ tb) & 0x80))
+
+/* the scans skip whole bytes where they can */
+static uint8_t fill_left(uint8_t *row, uint8_t x, uint8_t tb)
+{
+	while(x > clip_x0)
+	{
+		if(!(x & 7) && x - 8 >= clip_x0 && row[(x >> 3) - 1] == tb)
+		{
+			x -= 8;
+		}
+		else if(FILL_TEST(row, x - 1))
+		{
+			--x;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return x;
+}
+
+static uint8_t fill_right(uint8_t *row, uint8_t x, uint8_t tb)
+{
+	while(x < clip_x1)
+	{
+		if(!(x & 7) && x + 8 <= clip_x1 && row[x >> 3] == tb)
+		{
+			x += 8;
+		}
+		else if(FILL_TEST(row, x))
+		{
+			++x;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return x;
+}
+
+/* first pixel of the area from x on, > r if there is none */
+static uint8_t fill_next(uint8_t *row, uint8_t x, uint8_t r, uint8_t tb)
+{
+	while(x <= r)
+	{
+		if(!(x & 7) && row[x >> 3] == (uint8_t)~tb)
+		{
+			x += 8;
+		}
+		else if(FILL_TEST(row, x))
+		{
+			break;
+		}
+		else
+		{
+			++x;
+		}
+	}
+
+	return x;
+}
+
+/* x0 and x1 inclusive, every pixel of the span is in the area so
+   inverting it gives the fill color */
+static void fill_span(uint8_t *row, uint8_t x0, uint8_t x1)
+{
+	uint8_t *p, *e;
+	p = row + (x0 >> 3);
+	e = row + (x1 >> 3);
+	if(p == e)
+	{
+		*p ^= (0xFF >> (x0 & 7)) & (0xFF << (7 - (x1 & 7)));
+		return;
+	}
+
+	*p ^= 0xFF >> (x0 & 7);
+	for(++p; p < e; ++p)
+	{
+		*p = ~*p;
+	}
+
+	*e ^= 0xFF << (7 - (x1 & 7));
+}
+
+static void fill_push(uint8_t y, uint8_t l, uint8_t r, int8_t dy)
+{
+	fill_span_t *s;
+	if(y + dy < clip_y0 || y + dy >= clip_y1)
+	{
+		return;
+	}
+
+	s = &fill_stack[fill_n++];
+	s->y = y;
+	s->l = l;
+	s->r = r;
+	s->dy = dy;
+}
+
+/* the walk below fills what is left of an area one pixel at a time
+   when the stack is full, it needs no memory but is much slower */
+static uint8_t fill_in(int16_t x, int16_t y, uint8_t tb)
+{
+	uint8_t *row;
+	if(x < clip_x0 || x >= clip_x1 || y < clip_y0 || y >= clip_y1)
+	{
+		return 0;
+	}
+
+	row = draw_buf + y * draw_width;
+	return FILL_TEST(row, x);
+}
+
+/* runs of area pixels around (x, y) that hold one of its 4 neighbours,
+   the area stays connected without (x, y) if there is at most one.
+   Bit d of side tells which run the neighbour in direction d is in. */
+static uint8_t fill_groups(int16_t x, int16_t y, uint8_t tb, uint8_t *side)
+{
+	uint8_t i, k, bits = 0, run = 0, n = 0;
+	for(i = 0; i < 8; ++i)
+	{
+		if(fill_in(x + FILL_DX(i), y + FILL_DY(i), tb))
+		{
+			bits |= 1 << i;
+		}
+	}
+
+	*side = 0;
+	if(bits == 0xFF)
+	{
+		return 1;
+	}
+
+	for(k = 0; bits & (1 << k); ++k)
+	{
+	}
+
+	for(i = 0; i < 8; ++i)
+	{
+		k = (k + 1) & 7;
+		if(!(bits & (1 << k)))
+		{
+			n += run;
+			run = 0;
+		}
+		else if(!(k & 1))
+		{
+			run = 1;
+			if(n & 1)
+			{
+				*side |= 1 << (k >> 1);
+			}
+		}
+	}
+
+	return n;
+}
+
+/* direction of the next pixel along the edge of the area, which is
+   kept on the left, d is the direction the walk came in. 4 if none. */
+static uint8_t fill_exit(int16_t x, int16_t y, uint8_t d, uint8_t tb)
+{
+	uint8_t i, n;
+	for(i = 3; i < 7; ++i)
+	{
+		n = (d + i) & 3;
+		if(fill_in(x + FILL_DX(2 * n), y + FILL_DY(2 * n), tb))
+		{
+			return n;
+		}
+	}
+
+	return 4;
+}
+
+static uint8_t fill_step(int16_t *x, int16_t *y, uint8_t *d, uint8_t tb)
+{
+	uint8_t n = fill_exit(*x, *y, *d, tb);
+	if(n > 3)
+	{
+		return 0;
+	}
+
+	*x += FILL_DX(2 * n);
+	*y += FILL_DY(2 * n);
+	*d = n;
+	return 1;
+}
+
+/* the walk came in d from an area pixel of one run of a pixel between
+   2 runs and goes on into the other one */
+static uint8_t fill_cross(int16_t x, int16_t y, uint8_t d, uint8_t side,
+	uint8_t tb)
+{
+	uint8_t e = fill_exit(x, y, d, tb);
+	return fill_in(x - FILL_DX(2 * d), y - FILL_DY(2 * d), tb) &&
+		(((side >> ((d + 2) & 3)) ^ (side >> e)) & 1);
+}
+
+/* when such a walk comes back to (x, y) the way it came before it
+   passes it from anywhere else, the runs are joined around a hole */
+static uint8_t fill_once(int16_t x, int16_t y, uint8_t d, uint16_t lap,
+	uint8_t tb)
 {
-	uint8_t a, b, p, ex, ey;
-	const uint8_t *v;
-	a = y;
-	ex = x + 5;
-	ey = y + 7;
-	v = font5x7 + 5 * (c - 32);
-	if(ex < PWIDTH && ey < HEIGHT)
+	int16_t wx = x, wy = y;
+	while(--lap)
 	{
-		for(; x < ex; ++x, ++v)
+		fill_step(&wx, &wy, &d, tb);
+		if(wx == x && wy == y)
 		{
-			p = pgm_read_byte(v);
-			for(y = a, b = 1; y < ey; ++y, b <<= 1)
-			{
-				if(p & b)
-				{
-					video_sp(x, y);
-				}
-			}
+			return 0;
 		}
 	}
+
+	return 1;
 }
 
-void video_string(uint8_t x, uint8_t y, char *s)
+/* the same for up to k steps on both sides of (x, y) at once */
+static uint8_t fill_loop(int16_t x, int16_t y, uint8_t d, uint8_t side,
+	uint8_t k, uint8_t tb)
 {
-	while(*s)
+	int16_t ax = x, ay = y, bx = x, by = y;
+	uint8_t ad = d, bd, b0;
+	fill_step(&ax, &ay, &ad, tb);
+	b0 = bd = (ad + 2) & 3;
+	if(fill_cross(x, y, b0, side, tb))
 	{
-		video_char(x, y, *s++);
-		x += 6;
+		fill_step(&bx, &by, &bd, tb);
+	}
+	else
+	{
+		bx = -1;
 	}
-}
 
-void video_bitmap
-(uint8_t *img, uint8_t x0, uint8_t y0, uint8_t x1, uint16_t len)
-{
-	uint8_t *end, mask, sx = x0;
-	for(end = img + len; img < end; ++img)
+	while(k--)
 	{
-		for(mask = 1; mask < 0x80; mask <<= 1)
+		if(ax == x && ay == y)
 		{
-			if(*img & mask)
-			{
-				video_sp(x0, y0);
-			}
+			return ad == d;
+		}
 
-			if(++x0 == x1)
-			{
-				x0 = sx;
-				++y0;
-			}
+		if(bx == x && by == y)
+		{
+			return bd == b0;
+		}
+
+		fill_step(&ax, &ay, &ad, tb);
+		if(bx >= 0)
+		{
+			fill_step(&bx, &by, &bd, tb);
 		}
 	}
+
+	return 0;
 }
 
-void video_shift(uint8_t distance, uint8_t dir)
+/* fills the part of the area connected to (x, y) by walking along its
+   edge and taking every pixel the rest stays connected without, and
+   the pixels found on loops: by a short look round both sides, by a
+   mark that comes round again and, when the first mark after a take
+   shows a whole round went by without one, by searching that round. */
+static void fill_walk(int16_t x, int16_t y, uint8_t tb)
 {
-	switch(dir)
+	int16_t mx = -1, my = 0, cx = -1, cy = 0;
+	uint8_t d, g, s, c = 0, md = 0, cd = 0;
+	uint16_t n = 0, i;
+
+	/* a position the walk came to from an area pixel comes round again */
+	for(d = 0; d < 3; ++d)
 	{
-		case UP:
+		if(fill_in(x - FILL_DX(2 * d), y - FILL_DY(2 * d), tb))
 		{
-			uint8_t *src, *dst, *end;
-			dst = frame;
-			src = frame + distance * WIDTH;
-			end = frame + HEIGHT * WIDTH;
-			while(src <= end)
-			{
-				*dst = *src;
-				*src = 0;
-				++dst;
-				++src;
-			}
 			break;
 		}
+	}
 
-		case DOWN:
+	for(;;)
+	{
+		g = fill_groups(x, y, tb, &s);
+		if(g == 2)
 		{
-			uint8_t *src, *dst, *end;
-			dst = frame + HEIGHT * WIDTH;
-			src = dst - distance * WIDTH;
-			end = frame;
-			while(src >= end)
+			c = fill_cross(x, y, d, s, tb);
+			if(c && fill_loop(x, y, d, s, FILL_LOOK, tb))
 			{
-				*dst = *src;
-				*src = 0;
-				--dst;
-				--src;
+				g = 1;
+			}
+			else if(x == cx && y == cy)
+			{
+				if(d == cd)
+				{
+					g = 1;
+				}
+
+				cx = -1;
+			}
+			else if(cx < 0 && c)
+			{
+				cx = x;
+				cy = y;
+				cd = d;
 			}
-			break;
 		}
 
-		case LEFT:
+		if(g > 1 && x == mx && y == my && d == md)
 		{
-			uint8_t *src, *dst, *end, shift, tmp, line;
-			shift = distance & 7;
-			for(line = 0; line < HEIGHT; ++line)
+			for(i = 0; i < n; ++i)
 			{
-				dst = frame + WIDTH * line;
-				src = dst + distance / 8;
-				end = dst + WIDTH - 2;
-				while(src <= end)
+				if(fill_groups(x, y, tb, &s) == 2 &&
+					fill_cross(x, y, d, s, tb) && fill_once(x, y, d, n, tb))
 				{
-					tmp = 0;
-					tmp = *src << shift;
-					*src = 0;
-					++src;
-					tmp |= *src >> (8 - shift);
-					*dst = tmp;
-					++dst;
+					break;
 				}
 
-				tmp = 0;
-				tmp = *src << shift;
-				*src = 0;
-				*dst = tmp;
+				fill_step(&x, &y, &d, tb);
 			}
-			break;
+
+			/* not reached, every round has such a pixel */
+			if(i == n)
+			{
+				return;
+			}
+		}
+		else if(g > 1)
+		{
+			if(mx < 0 && fill_in(x - FILL_DX(2 * d), y - FILL_DY(2 * d), tb))
+			{
+				mx = x;
+				my = y;
+				md = d;
+				n = 0;
+			}
+
+			fill_step(&x, &y, &d, tb);
+			++n;
+			continue;
 		}
 
-		case RIGHT:
+		draw_buf[y * draw_width + (x >> 3)] ^= 0x80 >> (x & 7);
+		mx = -1;
+		cx = -1;
+		if(!fill_step(&x, &y, &d, tb))
 		{
-			uint8_t *src, *dst, *end, shift, tmp, line;
-			shift = distance & 7;
-			for(line = 0; line < HEIGHT; ++line)
+			return;
+		}
+	}
+}
+
+/* fills the 4-connected area of pixels that have the value of (x, y),
+   the edges of the clip rectangle bound it. A run found while the stack
+   is full is filled with the rest of the area behind it by fill_walk.
+   The spans cost about one pixel test per pixel. The walk costs up to
+   2 * FILL_LOOK edge steps of about 12 tests per pixel, and a loop
+   round a hole that neither the look ahead nor a mark finds costs one
+   search of up to L * L steps, L the length of the edge round it (at
+   most 4 per pixel of the area). So once it falls back to the walk a
+   fill is at worst quadratic in the size of the area; on random noise
+   with FILL_STACK 4 it took about 600 tests per pixel. */
+void video_fill(uint8_t x, uint8_t y)
+{
+	uint8_t *row, tb, l, r, pl, pr, ny, top, bottom;
+	int16_t ax = x + draw_ox, ay = y + draw_oy;
+	int8_t dy;
+	if(video_clip_code(ax, ay))
+	{
+		return;
+	}
+
+	x = ax;
+	y = ay;
+
+	row = draw_buf + y * draw_width;
+	tb = (row[x >> 3] & (0x80 >> (x & 7))) ? 0xFF : 0x00;
+	if((video_color == WHITE && tb) || (video_color == BLACK && !tb))
+	{
+		return;
+	}
+
+	l = fill_left(row, x, tb);
+	r = fill_right(row, x, tb) - 1;
+	fill_span(row, l, r);
+	fill_n = 0;
+	fill_push(y, l, r, -1);
+	fill_push(y, l, r, 1);
+	top = bottom = y;
+	while(fill_n)
+	{
+		--fill_n;
+		pl = fill_stack[fill_n].l;
+		pr = fill_stack[fill_n].r;
+		dy = fill_stack[fill_n].dy;
+		ny = fill_stack[fill_n].y + dy;
+		if(ny < top) { top = ny; }
+		if(ny > bottom) { bottom = ny; }
+		row = draw_buf + ny * draw_width;
+		for(x = fill_next(row, pl, pr, tb); x <= pr;
+			x = fill_next(row, x, pr, tb))
+		{
+			/* no room for the spans of this run */
+			if(fill_n > FILL_STACK - 3)
 			{
-				dst = frame + WIDTH - 1 + WIDTH * line;
-				src = dst - distance / 8;
-				end = dst - WIDTH + 2;
-				while(src >= end)
-				{
-					tmp = 0;
-					tmp = *src >> shift;
-					*src = 0;
-					--src;
-					tmp |= *src << (8 - shift);
-					*dst = tmp;
-					--dst;
-				}
+				fill_walk(x, ny, tb);
+				top = clip_y0;
+				bottom = clip_y1 - 1;
+				continue;
+			}
 
-				tmp = 0;
-				tmp = *src >> shift;
-				*src = 0;
-				*dst = tmp;
+			l = (x == pl) ? fill_left(row, x, tb) : x;
+			r = fill_right(row, x, tb) - 1;
+			fill_span(row, l, r);
+			fill_push(ny, l, r, dy);
+
+			/* the run reaches past the span it was found from, the
+			   row that span was on has to be scanned there too */
+			if(l < pl)
+			{
+				fill_push(ny, l, pl - 1, -dy);
 			}
-			break;
+
+			if(r > pr)
+			{
+				fill_push(ny, pr + 1, r, -dy);
+			}
+
+			x = r;
 		}
 	}
+
+#if defined(ENABLE_DIRTY)
+	video_dirty_clip(top, bottom + 1);
+#endif
 }
 
+#endif
+
+#endif /* !ENABLE_SPIRAM */
+
+#endif /* !ENABLE_DISPLAY_LIST */
+
 static void blank_line(void)
 {
 	if(scanLine == start_render)
 	{
+#if defined(ENABLE_DISPLAY_LIST)
 		renderLine = 0;
-		vscale = vscale_const;
+		video_dl_next();
+#else
+		renderLine = render_start + render_origin;
+		if(renderLine >= WIDTH * HEIGHT)
+		{
+			renderLine -= WIDTH * HEIGHT;
+		}
+#if defined(ENABLE_REGIONS)
+		video_region_start();
+#endif
+#endif
+#if defined(ENABLE_SPIRAM)
+		video_spi_start(renderLine);
+#endif
+		vsched = vscale_sched;
+		vmask = 0x80;
+		video_vscale_next();
 		line_handler = &active_line;
 	}
-	else if(scanLine == lines_frame)
+#if defined(ENABLE_DISPLAY_LIST)
+	else if(scanLine == start_render - DL_LEAD_LINES)
 	{
-		line_handler = &vsync_line;
+		video_dl_start(render_start ? 1 : 0, interlace ? 2 : 1);
+	}
+#endif
+	else if(scanLine == lines_end)
+	{
+		line_handler = interlace ? &vsync_field : &vsync_line;
 	}
 
+#if defined(ENABLE_INPUT)
+	input_line();
+#endif
 	++scanLine;
 }
 
@@ -407,20 +2037,135 @@ static void vsync_line(void)
 {
 	if(scanLine >= lines_frame)
 	{
+#if !defined(ENABLE_GENLOCK)
 		OCR1A = CYCLES_VIRT_SYNC;
+#endif
 		scanLine = 0;
 	}
 	else if(scanLine == vsync_end)
 	{
+#if !defined(ENABLE_GENLOCK)
 		OCR1A = CYCLES_HORZ_SYNC;
+#endif
 		line_handler = &blank_line;
 	}
 
+#if defined(ENABLE_INPUT)
+	input_line();
+#endif
 	++scanLine;
 }
 
+/* sync pulse of interlace slot k: the half lines of the vertical
+   interval, followed by the first full line of the field */
+static uint16_t vsync_pulse(uint8_t k)
+{
+	uint8_t j;
+	if(k > vhalf_end || k <= field)
+	{
+		return CYCLES_HORZ_SYNC;
+	}
+
+	j = k - 1 - field;
+	if(j < eq_pulses)
+	{
+		return CYCLES_EQ_SYNC;
+	}
+	else if(j < 2 * eq_pulses)
+	{
+		return cycles_broad;
+	}
+	else if(j < 3 * eq_pulses)
+	{
+		return CYCLES_EQ_SYNC;
+	}
+
+	/* half line without sync, OCR1A = 0 only leaves a one cycle spike */
+	return 0;
+}
+
+/* OCR1A is double buffered and applies to the next slot, ICR1 is not
+   and applies to the current one. Field 0 starts its interval on a
+   line boundary, field 1 with the half line that ends field 0 and
+   lies half a line higher, so it shows the even rows. */
+static void vsync_field(void)
+{
+	if(!vhalf)
+	{
+		field ^= 1;
+		vhalf_end = field + 3 * eq_pulses;
+		vhalf_end += vhalf_end & 1;
+	}
+	else if(vhalf == 1)
+	{
+		ICR1 = cycles_half;
+	}
+	else if(vhalf > vhalf_end)
+	{
+		ICR1 = cycles_line;
+		scanLine = vhalf_end / 2 + 1;
+		lines_end = lines_frame + field - 2;
+		render_start = field ? 0 : WIDTH;
+		vhalf = 0;
+		line_handler = &blank_line;
+#if defined(ENABLE_INPUT)
+		input_line();
+#endif
+		return;
+	}
+
+	OCR1A = vsync_pulse(++vhalf);
+#if defined(ENABLE_INPUT)
+	input_line();
+#endif
+}
+
+/* the row shown on the next line, also after a blank band line */
+static inline void active_line_next(void)
+{
+	if(!vscale)
+	{
+		video_vscale_next();
+#if defined(ENABLE_DISPLAY_LIST)
+		video_dl_next();
+#elif defined(ENABLE_REGIONS)
+		video_region_next();
+#else
+		if((renderLine += render_step) >= WIDTH * HEIGHT)
+		{
+			renderLine -= WIDTH * HEIGHT;
+		}
+#endif
+	}
+	else
+	{
+		--vscale;
+	}
+
+	if(scanLine++ == stop_render)
+	{
+		line_handler = &blank_line;
+#if defined(ENABLE_SPIRAM)
+		video_spi_stop();
+#endif
+	}
+#if defined(ENABLE_SPIRAM)
+	else
+	{
+		video_spi_next(renderLine);
+	}
+#endif
+}
+
 static void active_line(void)
 {
+#if defined(ENABLE_REGIONS)
+	if(region_blank)
+	{
+		active_line_next();
+		return;
+	}
+#endif
 	__asm__ __volatile__
 	(
 		"subi %[time], 10              \n"
@@ -439,7 +2184,44 @@ static void active_line(void)
 		:: [time] "a" (output_delay), [tcnt1l] "a" (TCNT1L)
 	);
 
-	#if RMETHOD >= 6
+	#if defined(ENABLE_GRAYSCALE)
+
+	/* GMETHOD cycles per pixel, 4 pixels per byte on bits 7 and 6 */
+	__asm__ __volatile__
+	(
+		".macro graywait               \n\t"
+		"    .rept %[wait]             \n\t"
+		"    nop                       \n\t"
+		"    .endr                     \n\t"
+		".endm                         \n\t"
+		".macro graybyte               \n\t"
+		"    LD   __tmp_reg__, X+      \n\t"
+		"    out  %[port], __tmp_reg__ \n\t"
+		"    graywait                  \n\t"
+		"    lsl  __tmp_reg__          \n\t"
+		"    lsl  __tmp_reg__          \n\t"
+		"    out  %[port], __tmp_reg__ \n\t"
+		"    graywait                  \n\t"
+		"    lsl  __tmp_reg__          \n\t"
+		"    lsl  __tmp_reg__          \n\t"
+		"    out  %[port], __tmp_reg__ \n\t"
+		"    graywait                  \n\t"
+		"    lsl  __tmp_reg__          \n\t"
+		"    lsl  __tmp_reg__          \n\t"
+		"    out  %[port], __tmp_reg__ \n\t"
+		"    graywait                  \n\t"
+		".endm                         \n\t"
+		"ADD  r26, r28                 \n\t"
+		"ADC  r27, r29                 \n\t"
+		".rept %[hres]                 \n\t"
+		"    graybyte                  \n\t"
+		".endr                         \n\t"
+		"out  %[port], __zero_reg__    \n\t"
+		:: [port] "i" (_SFR_IO_ADDR(VID_PORT)), "x" (SCAN_BUF),
+		"y" (renderLine), [hres] "i" (WIDTH), [wait] "i" (GMETHOD - 3)
+	);
+
+	#elif RMETHOD >= 6
 
 	__asm__ __volatile__
 	(
@@ -453,7 +2235,7 @@ static void active_line(void)
 		HWS_BLD
 		"    out  %[port],r16            \n"
 		"enter6:                       \n\t"
-		"    LD   __tmp_reg__, X+      \n\t"
+		PIX_LOAD
 		"    nop                       \n\t"
 		"    bst  __tmp_reg__, 7       \n\t"
 		HWS_BLD
@@ -506,8 +2288,9 @@ static void active_line(void)
 		HWS_BST
 		HWS_BLD
 		"    out  %[port], r16           \n"
-		:: [port] "i" (_SFR_IO_ADDR(VID_PORT)), "x" (frame),
-		"y" (renderLine), [hres] "d" (WIDTH) : "r16"
+		:: [port] "i" (_SFR_IO_ADDR(VID_PORT)), "x" (SCAN_BUF),
+		"y" (renderLine), [hres] "d" (WIDTH),
+		[spdr] "i" (_SFR_IO_ADDR(SPDR)) : "r16"
 	);
 
 	#elif RMETHOD == 5
@@ -524,7 +2307,7 @@ static void active_line(void)
 		HWS_BLD
 		"    out  %[port], r16           \n"
 		"enter5:                       \n\t"
-		"    LD   __tmp_reg__, X+      \n\t"
+		PIX_LOAD
 		"    bst  __tmp_reg__, 7       \n\t"
 		HWS_BLD
 		"    out  %[port], r16           \n"
@@ -568,8 +2351,9 @@ static void active_line(void)
 		HWS_BST
 		HWS_BLD
 		"    out   %[port], r16          \n"
-		:: [port] "i" (_SFR_IO_ADDR(VID_PORT)), "x" (frame),
-		"y" (renderLine), [hres] "d" (WIDTH) : "r16"
+		:: [port] "i" (_SFR_IO_ADDR(VID_PORT)), "x" (SCAN_BUF),
+		"y" (renderLine), [hres] "d" (WIDTH),
+		[spdr] "i" (_SFR_IO_ADDR(SPDR)) : "r16"
 	);
 
 	#elif RMETHOD == 4
@@ -583,7 +2367,7 @@ static void active_line(void)
 		"    lsl  __tmp_reg__          \n\t"
 		"    out  %[port], __tmp_reg__ \n\t"
 		"enter4:                       \n\t"
-		"    LD   __tmp_reg__, X+      \n\t"
+		PIX_LOAD
 		"    nop                       \n\t"
 		"    out  %[port], __tmp_reg__ \n\t"
 		"    nop                       \n\t"
@@ -618,8 +2402,9 @@ static void active_line(void)
 		"    nop                       \n\t"
 		"    nop                       \n\t"
 		"    cbi  %[port], 7           \n\t"
-		:: [port] "i" (_SFR_IO_ADDR(VID_PORT)), "x" (frame),
-		"y" (renderLine), [hres] "d" (WIDTH) : "r16"
+		:: [port] "i" (_SFR_IO_ADDR(VID_PORT)), "x" (SCAN_BUF),
+		"y" (renderLine), [hres] "d" (WIDTH),
+		[spdr] "i" (_SFR_IO_ADDR(SPDR)) : "r16"
 	);
 
 	#elif RMETHOD <= 3
@@ -628,7 +2413,7 @@ static void active_line(void)
 	__asm__ __volatile__
 	(
 		".macro byteshift              \n\t"
-		"    LD   __tmp_reg__, X+      \n\t"
+		PIX_LOAD
 		"    out  %[port], __tmp_reg__ \n\t"
 		"    nop                       \n\t"
 		"    lsl  __tmp_reg__          \n\t"
@@ -720,29 +2505,176 @@ static void active_line(void)
 		"    nop                       \n\t"
 		"    nop                       \n\t"
 		"    cbi %[port], 7            \n\t"
-		:: [port] "i" (_SFR_IO_ADDR(VID_PORT)), "x" (frame),
-		"y" (renderLine), [hres] "d" (WIDTH) : "r16"
+		:: [port] "i" (_SFR_IO_ADDR(VID_PORT)), "x" (SCAN_BUF),
+		"y" (renderLine), [hres] "d" (WIDTH),
+		[spdr] "i" (_SFR_IO_ADDR(SPDR)) : "r16"
 	);
 
 	#endif
 
-	if(!vscale)
+	active_line_next();
+}
+
+#if defined(ENABLE_GENLOCK)
+
+uint8_t video_genlock_locked(void)
+{
+	return gl_lock >= GENLOCK_LINES;
+}
+
+int16_t video_genlock_error(void)
+{
+	int16_t e;
+	cli();
+	e = gl_err;
+	sei();
+	return e;
+}
+
+/* before the line handler. Once locked, a line that is still in sync
+   after CYCLES_GENLOCK_SAMPLE starts with a broad pulse. The first line
+   after them gets its number counted from the first broad line, as in
+   the frames made without genlock, so every field of the signal starts
+   a frame. The wait ends long before the pixel output. */
+static void genlock_vsync(void)
+{
+	if(gl_lock < GENLOCK_LINES)
 	{
-		vscale = vscale_const;
-		renderLine += WIDTH;
+		gl_broad = 0;
+		return;
 	}
-	else
+
+	while(TCNT1 < CYCLES_GENLOCK_SAMPLE)
 	{
-		--vscale;
 	}
 
-	if(scanLine++ == (int)(start_render + HEIGHT * (vscale_const + 1)))
+	if(GENLOCK_IN)
+	{
+		if(gl_broad < 0xFF)
+		{
+			++gl_broad;
+		}
+
+		return;
+	}
+
+	if(gl_broad >= 2)
 	{
+#if defined(ENABLE_SPIRAM)
+		if(line_handler == &active_line)
+		{
+			video_spi_stop();
+		}
+#endif
+		scanLine = gl_broad;
 		line_handler = &blank_line;
 	}
+
+	gl_broad = 0;
+}
+
+/* after the line handler. The sync edge of this line was captured
+   near 0, or near TOP at the end of the last line if it came early,
+   and is then counted back by the TOP that line really had. Half the
+   phase error goes into the next period and the sum of the errors
+   trims it to the line rate of the signal. Once locked, edges half a
+   line off are equalizing and broad pulses and left out.
+   tools/genlock_model.c runs the same arithmetic on the host. */
+static void genlock_hsync(void)
+{
+	uint16_t top = gl_top;
+	int16_t e;
+	gl_top = OCR1A;
+	if(!(TIFR1 & (1 << ICF1)))
+	{
+		gl_lock = 0;
+		return;
+	}
+
+	e = ICR1;
+	TIFR1 = (1 << ICF1);
+	if(e > (int16_t)(top / 2))
+	{
+		e -= top + 1;
+	}
+
+	if(gl_lock >= GENLOCK_LINES &&
+		(e > (int16_t)(cycles_line / 4) || e < -(int16_t)(cycles_line / 4)))
+	{
+		return;
+	}
+
+	gl_err = e;
+	gl_trim += e;
+	if(gl_trim > GENLOCK_RANGE * 16)
+	{
+		gl_trim = GENLOCK_RANGE * 16;
+	}
+	else if(gl_trim < -GENLOCK_RANGE * 16)
+	{
+		gl_trim = -GENLOCK_RANGE * 16;
+	}
+
+	OCR1A = cycles_line + (gl_trim >> 4) + (e >> 1);
+	if(e > GENLOCK_TOL || e < -GENLOCK_TOL)
+	{
+		gl_lock = 0;
+	}
+	else if(gl_lock < 0xFF)
+	{
+		++gl_lock;
+	}
+}
+
+#endif
+
+#if defined(ENABLE_DISPLAY_LIST)
+
+ISR(TIMER1_COMPB_vect)
+{
+#if defined(ENABLE_SOUND)
+	uint8_t tick = !(vhalf & 1) || vhalf > vhalf_end;
+#endif
+	line_handler();
+#if defined(ENABLE_SOUND)
+	if(tick)
+	{
+		sound_tick();
+	}
+#endif
+	video_dl_render();
 }
 
+#else
+
 ISR(TIMER1_OVF_vect)
 {
+#if defined(ENABLE_SOUND)
+	/* once per line, the interlace vertical interval runs in half lines */
+	uint8_t tick = !(vhalf & 1) || vhalf > vhalf_end;
+#endif
+#if defined(ENABLE_GENLOCK)
+	genlock_vsync();
+#endif
 	line_handler();
+#if defined(ENABLE_GENLOCK)
+	genlock_hsync();
+#endif
+#if defined(ENABLE_SOUND)
+	if(tick)
+	{
+		sound_tick();
+	}
+#endif
+#if defined(ENABLE_TERMINAL)
+	term_rx();
+#endif
+#if defined(ENABLE_MIRROR)
+	mirror_line();
+#endif
+#if defined(ENABLE_DEFERRED)
+	video_defer_run();
+#endif
 }
+
+#endif
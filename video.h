@@ -12,6 +12,86 @@ void video_begin(uint8_t mode);
 void video_sp(uint8_t x, uint8_t y);
 
 void video_set_color(uint8_t color);
+
+/* a font made by tools/fontc, in flash. Glyph g of character c is
+   map[c - first] (or c - first without a map), width[g] pixels wide
+   and height rows of (width[g] + 7) / 8 bytes at bitmap + offset[g]. */
+typedef struct
+{
+	uint8_t height, first, last;
+	const uint8_t *map;
+	const uint8_t *width;
+	const uint16_t *offset;
+	const uint8_t *bitmap;
+} video_font_t;
+
+/* the built-in font of video_char, video_string, the display list and
+   the terminal, made from fonts/5x7.bdf */
+extern const video_font_t font5x7;
+
+uint8_t video_font_glyph(const video_font_t *h, uint8_t c);
+
+#if defined(ENABLE_DISPLAY_LIST)
+
+extern uint8_t *dl_front;
+
+void video_dl_clear(void);
+uint8_t video_dl_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+uint8_t video_dl_line(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+uint8_t video_dl_string(uint8_t x, uint8_t y, char *s);
+uint8_t video_dl_bitmap
+	(const uint8_t *img, uint8_t x, uint8_t y, uint8_t w, uint8_t h);
+uint16_t video_dl_overruns(void);
+uint8_t video_dl_load(void);
+void video_dl_reset_stats(void);
+
+void video_dl_start(uint8_t row, uint8_t step);
+void video_dl_next(void);
+void video_dl_render(void);
+
+#else
+
+/* results of video_clip */
+#define CLIP_OUT     0
+#define CLIP_PART    1
+#define CLIP_IN      2
+
+/* outcodes of video_clip_code */
+#define CLIP_LEFT    0x01
+#define CLIP_RIGHT   0x02
+#define CLIP_TOP     0x04
+#define CLIP_BOTTOM  0x08
+
+void video_set_origin(uint8_t y);
+void video_set_clip(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+void video_set_draw_origin(int16_t x, int16_t y);
+uint8_t video_clip_code(int16_t x, int16_t y);
+uint8_t video_clip(int16_t *x0, int16_t *y0, int16_t *x1, int16_t *y1);
+#if defined(ENABLE_REGIONS)
+
+/* rows screen rows showing the frame from row start on, each frame row
+   on scale screen rows. Scale 0 blanks the band. */
+typedef struct
+{
+	uint8_t rows, start, scale;
+} video_region_t;
+
+void video_set_regions(const video_region_t *r, uint8_t n);
+
+#endif
+#if defined(ENABLE_DIRTY)
+
+/* row y is bit 7 - y % 8 of byte y / 8 of the bitmap */
+#define DIRTY_BYTES ((HEIGHT + 7) / 8)
+
+void video_dirty_mark(uint8_t y0, uint8_t y1);
+uint8_t video_dirty_row(uint8_t y);
+void video_dirty_take(uint8_t *rows);
+uint8_t video_dirty_next(const uint8_t *rows, uint8_t y);
+
+void video_dirty_clip(int16_t y0, int16_t y1);
+
+#endif
 void video_set_pixel(uint8_t x, uint8_t y);
 uint8_t video_get_pixel(uint8_t x, uint8_t y);
 void video_clear(void);
@@ -22,8 +102,100 @@ void video_vline(uint8_t x, uint8_t y, uint8_t l);
 void video_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
 void video_char(uint8_t x, uint8_t y, char c);
 void video_string(uint8_t x, uint8_t y, char *s);
+uint16_t video_text(const video_font_t *f, uint8_t x, uint8_t y,
+	const char *s);
+uint16_t video_text_width(const video_font_t *f, const char *s);
 void video_bitmap
 	(uint8_t *img, uint8_t x0, uint8_t y0, uint8_t x1, uint16_t len);
+#if defined(ENABLE_SPIRAM)
+
+/* pages of the SPI SRAM the primitives draw into and that is shown
+   from the next field on */
+void video_spi_page(uint8_t draw, uint8_t show);
+
+void video_spi_begin(void);
+void video_spi_start(uint16_t offset);
+void video_spi_next(uint16_t offset);
+void video_spi_stop(void);
+
+#else
+
+/* off-screen bitmap in the framebuffer format, width in bytes. Only
+   the first 255 pixels of a wider one are drawn into. */
+typedef struct
+{
+	uint8_t *data;
+	uint8_t width, height;
+} video_surface_t;
+
+void video_set_surface(video_surface_t *s);
+video_surface_t *video_get_surface(void);
+void video_blit(const video_surface_t *s, uint8_t x, uint8_t y);
 void video_shift(uint8_t distance, uint8_t dir);
+void video_fill_circle(int16_t x0, int16_t y0, int16_t radius);
+uint8_t video_fill_polygon(const int16_t *xy, uint8_t n);
+
+#if !defined(ENABLE_GRAYSCALE)
+void video_fill(uint8_t x, uint8_t y);
+void video_set_pattern(const uint8_t *p);
+const uint8_t *video_get_pattern(void);
+void video_set_dither(uint8_t level);
+#endif
+
+#endif
+
+#if defined(ENABLE_3D)
+
+/* model vertex, coordinates from -127 to 127 */
+typedef struct
+{
+	int8_t x, y, z;
+} v3d_vertex_t;
+
+/* vertex and edge arrays are in flash */
+#define V3D_PROGMEM 1
+
+int16_t video_3d_sin(uint8_t a);
+int16_t video_3d_cos(uint8_t a);
+void video_3d_rotate(uint8_t ax, uint8_t ay, uint8_t az);
+void video_3d_view(int16_t cx, int16_t cy, int16_t dist, int16_t focal);
+uint8_t video_3d_project(const v3d_vertex_t *v, uint8_t n, uint8_t flags);
+void video_3d_edges(const uint8_t *e, uint8_t n, uint8_t flags);
+void video_3d_draw(const v3d_vertex_t *v, uint8_t nv,
+	const uint8_t *e, uint8_t ne, uint8_t flags);
+
+#endif
+
+#if defined(ENABLE_DEFERRED)
+
+/* same arguments as the video_* call of the same name, queued and
+   drawn in the vertical blanking; return 0 if the queue is full.
+   Commands always draw solid, the pattern does not apply to them.
+   A command borrows the drawing state (target, clip, origin, color)
+   while it runs from the line interrupt, so while commands are queued
+   the main loop must only draw through the queue. Call
+   video_defer_flush() before drawing or setting that state directly. */
+uint8_t video_defer_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1);
+uint8_t video_defer_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+uint8_t video_defer_string(uint8_t x, uint8_t y, char *s);
+uint8_t video_defer_bitmap
+	(uint8_t *img, uint8_t x0, uint8_t y0, uint8_t x1, uint16_t len);
+uint8_t video_defer_shift(uint8_t distance, uint8_t dir);
+void video_defer_flush(void);
+
+void video_defer_run(void);
+
+#endif
+
+#if defined(ENABLE_GENLOCK)
+
+/* 1 once GENLOCK_LINES lines in a row were within GENLOCK_TOL cycles
+   of the external sync, and the phase error of the last one */
+uint8_t video_genlock_locked(void);
+int16_t video_genlock_error(void);
+
+#endif
+
+#endif
 
 #endif /* __VIDEO_H__ */
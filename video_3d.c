@@ -0,0 +1,185 @@
+#include "video.h"
+
+#if defined(ENABLE_3D)
+
+extern int16_t draw_ox, draw_oy;
+
+/* projected vertex that is behind the camera */
+#define V3D_BEHIND  0x10
+
+/* sin in 8.8 fixed point for a quarter turn of 64 steps */
+static const int16_t v3d_sine[65] PROGMEM =
+{
+	  0,   6,  13,  19,  25,  31,  38,  44,  50,  56,  62,  68,  74,
+	 80,  86,  92,  98, 104, 109, 115, 121, 126, 132, 137, 142, 147,
+	152, 157, 162, 167, 172, 177, 181, 185, 190, 194, 198, 202, 206,
+	209, 213, 216, 220, 223, 226, 229, 231, 234, 237, 239, 241, 243,
+	245, 247, 248, 250, 251, 252, 253, 254, 255, 255, 256, 256, 256
+};
+
+/* rotation matrix in 8.8, projection center, camera distance in model
+   units and focal length */
+static int16_t v3d_m[9];
+static int16_t v3d_cx = PWIDTH / 2, v3d_cy = HEIGHT / 2;
+static int16_t v3d_dist = 256, v3d_focal = 64;
+
+/* projected vertices of the last video_3d_project */
+static int16_t v3d_x[V3D_VERTICES], v3d_y[V3D_VERTICES];
+static uint8_t v3d_code[V3D_VERTICES], v3d_n;
+
+/* 256 steps per turn */
+int16_t video_3d_sin(uint8_t a)
+{
+	if(a < 64)
+	{
+		return pgm_read_word(v3d_sine + a);
+	}
+	else if(a < 128)
+	{
+		return pgm_read_word(v3d_sine + 128 - a);
+	}
+	else if(a < 192)
+	{
+		return -(int16_t)pgm_read_word(v3d_sine + a - 128);
+	}
+
+	return -(int16_t)pgm_read_word(v3d_sine + (uint8_t)(0 - a));
+}
+
+int16_t video_3d_cos(uint8_t a)
+{
+	return video_3d_sin(a + 64);
+}
+
+static int16_t v3d_mul(int16_t a, int16_t b)
+{
+	return ((int32_t)a * b) >> 8;
+}
+
+/* rotation about x, then y, then z */
+void video_3d_rotate(uint8_t ax, uint8_t ay, uint8_t az)
+{
+	int16_t sx = video_3d_sin(ax), cx = video_3d_cos(ax);
+	int16_t sy = video_3d_sin(ay), cy = video_3d_cos(ay);
+	int16_t sz = video_3d_sin(az), cz = video_3d_cos(az);
+	int16_t sxsy = v3d_mul(sx, sy), cxsy = v3d_mul(cx, sy);
+	v3d_m[0] = v3d_mul(cy, cz);
+	v3d_m[1] = v3d_mul(sxsy, cz) - v3d_mul(cx, sz);
+	v3d_m[2] = v3d_mul(cxsy, cz) + v3d_mul(sx, sz);
+	v3d_m[3] = v3d_mul(cy, sz);
+	v3d_m[4] = v3d_mul(sxsy, sz) + v3d_mul(cx, cz);
+	v3d_m[5] = v3d_mul(cxsy, sz) - v3d_mul(sx, cz);
+	v3d_m[6] = -sy;
+	v3d_m[7] = v3d_mul(sx, cy);
+	v3d_m[8] = v3d_mul(cx, cy);
+}
+
+/* dist must be larger than the radius of the model */
+void video_3d_view(int16_t cx, int16_t cy, int16_t dist, int16_t focal)
+{
+	v3d_cx = cx;
+	v3d_cy = cy;
+	v3d_dist = dist;
+	v3d_focal = focal;
+}
+
+/* one row of the matrix times a vertex, in quarter model units. Every
+   product fits in 16 bits because the coordinates stay within 127. */
+static int16_t v3d_row(const int16_t *m, int8_t x, int8_t y, int8_t z)
+{
+	return ((m[0] * x >> 2) + (m[1] * y >> 2) + (m[2] * z >> 2)) >> 4;
+}
+
+/* rotates, projects and classifies up to V3D_VERTICES vertices, one
+   division per vertex, against the clip rectangle. Returns the number
+   that was projected. */
+uint8_t video_3d_project(const v3d_vertex_t *v, uint8_t n, uint8_t flags)
+{
+	uint8_t i;
+	int8_t x, y, z;
+	int16_t rx, ry, rz, sx, sy;
+	int32_t r;
+	if(n > V3D_VERTICES)
+	{
+		n = V3D_VERTICES;
+	}
+
+	for(i = 0; i < n; ++i, ++v)
+	{
+		if(flags & V3D_PROGMEM)
+		{
+			x = pgm_read_byte(&v->x);
+			y = pgm_read_byte(&v->y);
+			z = pgm_read_byte(&v->z);
+		}
+		else
+		{
+			x = v->x;
+			y = v->y;
+			z = v->z;
+		}
+
+		rx = v3d_row(v3d_m, x, y, z);
+		ry = v3d_row(v3d_m + 3, x, y, z);
+		rz = v3d_row(v3d_m + 6, x, y, z) + (v3d_dist << 2);
+		if(rz < 4)
+		{
+			v3d_code[i] = V3D_BEHIND;
+			continue;
+		}
+
+		r = ((int32_t)v3d_focal << 14) / rz;
+		sx = v3d_cx + (int16_t)((rx * r) >> 14);
+		sy = v3d_cy - (int16_t)((ry * r) >> 14);
+		v3d_x[i] = sx;
+		v3d_y[i] = sy;
+		v3d_code[i] = video_clip_code(sx + draw_ox, sy + draw_oy);
+	}
+
+	v3d_n = n;
+	return n;
+}
+
+/* n edges of two vertex indices each. Edges beyond one side of the
+   clip rectangle or behind the camera are dropped here, the line sorts
+   out the rest. */
+void video_3d_edges(const uint8_t *e, uint8_t n, uint8_t flags)
+{
+	uint8_t a, b, ca, cb;
+	for(; n; --n, e += 2)
+	{
+		if(flags & V3D_PROGMEM)
+		{
+			a = pgm_read_byte(e);
+			b = pgm_read_byte(e + 1);
+		}
+		else
+		{
+			a = e[0];
+			b = e[1];
+		}
+
+		if(a >= v3d_n || b >= v3d_n)
+		{
+			continue;
+		}
+
+		ca = v3d_code[a];
+		cb = v3d_code[b];
+		if(((ca | cb) & V3D_BEHIND) || (ca & cb))
+		{
+			continue;
+		}
+
+		video_line(v3d_x[a], v3d_y[a], v3d_x[b], v3d_y[b]);
+	}
+}
+
+void video_3d_draw(const v3d_vertex_t *v, uint8_t nv,
+	const uint8_t *e, uint8_t ne, uint8_t flags)
+{
+	video_3d_project(v, nv, flags);
+	video_3d_edges(e, ne, flags);
+}
+
+#endif /* ENABLE_3D */
@@ -1,28 +1,165 @@
 #ifndef __VIDEO_SETTINGS_H__
 #define __VIDEO_SETTINGS_H__
 
-#define NTSC     0
-#define PAL      1
+#define NTSC      0
+#define PAL       1
+#define INTERLACE 2
 
 #define BLACK    0
 #define WHITE    1
 #define INVERT   2
 
+/* only with ENABLE_GRAYSCALE */
+#define DARK_GRAY  3
+#define LIGHT_GRAY 4
+
 #define UP       0
 #define DOWN     1
 #define LEFT     2
 #define RIGHT    3
 
+/* in INTERLACE mode each field shows every other row, so HEIGHT
+   can be doubled on parts with enough SRAM (atmega1284P, 2560) */
+/* 2 bits per pixel on VID_PIN and VID_PIN - 1 through a resistor
+   ladder, needs ENABLE_FAST_OUTPUT and VID_PIN 7 */
+/* #define ENABLE_GRAYSCALE */
+
+#if defined(ENABLE_GRAYSCALE)
+#define BPP      2
+#else
+#define BPP      1
+#endif
+
+/* no framebuffer, rows are rendered from a display list into a
+   double line buffer while the previous row is on screen */
+/* #define ENABLE_DISPLAY_LIST */
+
+/* display list items, lines of lead for the first row and cycles
+   the line interrupt fires ahead of the pixel output */
+#define DL_ITEMS         16
+#define DL_LEAD_LINES     8
+#define DL_ISR_LEAD      96
+
+/* queue of drawing commands executed in the vertical blanking */
+/* #define ENABLE_DEFERRED */
+
+/* queue size (power of 2), most blanking lines spent per frame and
+   lines before the active area where no new command is started */
+#define DQ_SIZE           8
+#define DQ_LINES         40
+#define DQ_GUARD          2
+
+/* PWM sound on OC2A, updated once per scanline by the line interrupt */
+/* #define ENABLE_SOUND */
+
+/* sample queue fed by the main loop (power of 2) */
+#define SND_QUEUE        32
+
+/* PS/2 keyboard and NES/SNES pads, sampled in the blanking lines */
+/* #define ENABLE_INPUT */
+
+/* event queue (power of 2), lines the keyboard is inhibited before the
+   active area (at least 100 us) and bits shifted out of each pad */
+#define INPUT_QUEUE      16
+#define INPUT_GUARD       3
+#define PAD_BITS         16
+
+/* pads share latch and clock */
+#define PAD_PORT   PORTC
+#define PAD_DDR    DDRC
+#define PAD_IN     PINC
+#define PAD_LATCH 2
+#define PAD_CLOCK 3
+#define PAD_DATA0 4
+#define PAD_DATA1 5
+
+/* VT100 subset on USART0, 6x8 character cells */
+/* #define ENABLE_TERMINAL */
+
+/* receive ring (power of 2) and baud rate */
+#define TERM_RX          64
+#define TERM_BAUD    115200
+
+/* changed rows of the framebuffer sent over the USART0 TX, PackBits
+   compressed, for tools/mirror.c on the host */
+/* #define ENABLE_MIRROR */
+
+/* output ring (power of 2), encoder steps per blanking line, lines
+   before the active area where it stops and baud rate */
+#define MIRROR_BUF       64
+#define MIRROR_CHUNK     16
+#define MIRROR_GUARD      2
+#define MIRROR_BAUD  115200
+
+/* framebuffer in a 23LC1024 SPI SRAM on the SPI pins, CS on SS. Every
+   active line is streamed from it in sequential read mode while the
+   pixels are shifted out, so WIDTH * HEIGHT is not limited by the
+   internal SRAM. 1bpp only, every output method takes more than
+   the 17 cycles the SPI needs for a byte. */
+/* #define ENABLE_SPIRAM */
+
+/* size of the SRAM in bytes, it holds SPIRAM_PAGES frames */
+#define SPIRAM_SIZE  131072UL
+
+/* fixed point rotation and projection of wireframe models */
+/* #define ENABLE_3D */
+
+/* most vertices of a model, 5 bytes each */
+#define V3D_VERTICES     16
+
+/* spans video_fill can keep pending, 4 bytes each */
+#define FILL_STACK       32
+
+/* steps video_fill looks along an edge for a loop once the stack is
+   full, at most 255 */
+#define FILL_LOOK        128
+
+/* most vertices of video_fill_polygon, 12 bytes of stack each */
+#define POLY_VERTICES    8
+
+/* bands of screen rows scanned out from their own frame row, with
+   their own vertical scale or blanked, see video_set_regions */
+/* #define ENABLE_REGIONS */
+
+/* most bands of the region table, 3 bytes each */
+#define REGIONS          4
+
+/* bitmap of the framebuffer rows changed by the primitives since it
+   was last taken, see video_dirty_take */
+/* #define ENABLE_DIRTY */
+
+/* overlay on an external composite signal: the line timer follows its
+   sync through the input capture unit and no sync is generated. The
+   pixels drive the video line through a diode, so black ones leave
+   the picture as it is. Not interlaced. */
+/* #define ENABLE_GENLOCK */
+
+/* sync from an active low sync separator (LM1881) on ICP1 instead of
+   the analog comparator, with the video on ADC channel GENLOCK_MUX
+   and a slicing level between sync tip and black on AIN0 */
+/* #define GENLOCK_ICP */
+#define GENLOCK_MUX       0
+
+/* phase error in cycles that counts as locked, locked lines before
+   the vertical sync is looked for and the most cycles the line period
+   is trimmed by */
+#define GENLOCK_TOL       8
+#define GENLOCK_LINES    16
+#define GENLOCK_RANGE    64
+
 #define WIDTH   20
-#define PWIDTH    (8 * WIDTH)
+#define PWIDTH    (8 / BPP * WIDTH)
 #define HEIGHT  96
 
+#define SPIRAM_PAGES (SPIRAM_SIZE / (WIDTH * HEIGHT))
+
 #define CYCLES_PER_US \
 (F_CPU / 1000000)
 
 #define TIME_HORZ_SYNC           4.7
 #define TIME_VIRT_SYNC          58.85
 #define TIME_ACTIVE             46
+#define TIME_EQ_SYNC             2.3
 
 #define CYCLES_VIRT_SYNC \
 ((TIME_VIRT_SYNC * CYCLES_PER_US) - 1)
@@ -30,13 +167,24 @@
 #define CYCLES_HORZ_SYNC \
 ((TIME_HORZ_SYNC * CYCLES_PER_US) - 1)
 
+#define CYCLES_EQ_SYNC \
+((TIME_EQ_SYNC * CYCLES_PER_US) - 1)
+
+/* past the end of a line sync, still inside a broad pulse */
+#define TIME_GENLOCK_SAMPLE      6
+
+#define CYCLES_GENLOCK_SAMPLE \
+(TIME_GENLOCK_SAMPLE * CYCLES_PER_US)
+
 /* timing settings for NTSC */
 #define NTSC_TIME_SCANLINE      63.55
 #define NTSC_TIME_OUTPUT_START  12
 #define NTSC_LINE_FRAME        262
+#define NTSC_LINE_RATE       15734
 #define NTSC_LINE_START_VSYNC    0
 #define NTSC_LINE_STOP_VSYNC     3
 #define NTSC_LINE_DISPLAY      216
+#define NTSC_EQ_PULSES           6
 
 #define NTSC_LINE_MID \
 ((NTSC_LINE_FRAME - NTSC_LINE_DISPLAY) / 2 + NTSC_LINE_DISPLAY / 2)
@@ -47,19 +195,24 @@
 #define NTSC_CYCLES_OUTPUT_START \
 ((NTSC_TIME_OUTPUT_START * CYCLES_PER_US) - 1)
 
-#define VSCALE_NTSC \
-(NTSC_LINE_DISPLAY / HEIGHT - 1)
+#define NTSC_CYCLES_HALFLINE \
+((NTSC_TIME_SCANLINE / 2 * CYCLES_PER_US) - 1)
+
+#define NTSC_CYCLES_BROAD_SYNC \
+(((NTSC_TIME_SCANLINE / 2 - TIME_HORZ_SYNC) * CYCLES_PER_US) - 1)
 
 #define START_RENDER_NTSC \
-(NTSC_LINE_MID - ((HEIGHT * (VSCALE_NTSC + 1)) / 2) + 8)
+(NTSC_LINE_MID - (NTSC_LINE_DISPLAY / 2) + 8)
 
 /* timing settings for PAL */
 #define PAL_TIME_SCANLINE       64
 #define PAL_TIME_OUTPUT_START   12.5
 #define PAL_LINE_FRAME         312
+#define PAL_LINE_RATE        15625
 #define PAL_LINE_START_VSYNC     0
 #define PAL_LINE_STOP_VSYNC      7
 #define PAL_LINE_DISPLAY       260
+#define PAL_EQ_PULSES            5
 
 #define PAL_LINE_MID \
 ((PAL_LINE_FRAME - PAL_LINE_DISPLAY) / 2 + PAL_LINE_DISPLAY / 2)
@@ -70,13 +223,20 @@
 #define PAL_CYCLES_OUTPUT_START \
 ((PAL_TIME_OUTPUT_START * CYCLES_PER_US) - 1)
 
-#define VSCALE_PAL \
-(PAL_LINE_DISPLAY / HEIGHT - 1)
+#define PAL_CYCLES_HALFLINE \
+((PAL_TIME_SCANLINE / 2 * CYCLES_PER_US) - 1)
+
+#define PAL_CYCLES_BROAD_SYNC \
+(((PAL_TIME_SCANLINE / 2 - TIME_HORZ_SYNC) * CYCLES_PER_US) - 1)
 
 #define START_RENDER_PAL \
-(PAL_LINE_MID - ((HEIGHT * (VSCALE_PAL + 1)) / 2))
+(PAL_LINE_MID - (PAL_LINE_DISPLAY / 2))
+
+/* one bit per framebuffer row, set if the row is repeated one extra line */
+#define VSCALE_SCHED_SIZE (HEIGHT / 8 + 1)
 
 #define RMETHOD (TIME_ACTIVE * CYCLES_PER_US) / PWIDTH
+#define GMETHOD RMETHOD
 
 /* sync output is on OC1A */
 #define ENABLE_FAST_OUTPUT
@@ -105,6 +265,33 @@ defined(__AVR_ATmega2560__) || defined(__AVR_ATmega2561__)
 #define SYNC_DDR   DDRB
 #define SYNC_PIN  5
 
+/* input capture */
+#define ICP_IN     PIND
+#define ICP_PIN   4
+
+/* sound */
+#define SND_DDR    DDRB
+#define SND_PIN   4
+
+/* spi */
+#define SPI_PORT   PORTB
+#define SPI_DDR    DDRB
+#define SPI_SS    0
+#define SPI_SCK   1
+#define SPI_MOSI  2
+#define SPI_MISO  3
+
+/* keyboard clock and data, the clock on a pin change interrupt */
+#define PS2_PORT   PORTK
+#define PS2_DDR    DDRK
+#define PS2_IN     PINK
+#define PS2_CLK   0
+#define PS2_DATA  1
+#define PS2_PCMSK  PCMSK2
+#define PS2_PCIE  PCIE2
+#define PS2_PCIF  PCIF2
+#define PS2_vect   PCINT2_vect
+
 #elif defined(__AVR_ATmega644__) || defined(__AVR_ATmega644P__) || \
 defined(__AVR_ATmega1284__) || defined(__AVR_ATmega1284P__)
 
@@ -128,6 +315,33 @@ defined(__AVR_ATmega1284__) || defined(__AVR_ATmega1284P__)
 #define SYNC_DDR   DDRD
 #define SYNC_PIN  5
 
+/* input capture */
+#define ICP_IN     PIND
+#define ICP_PIN   6
+
+/* sound */
+#define SND_DDR    DDRD
+#define SND_PIN   7
+
+/* spi */
+#define SPI_PORT   PORTB
+#define SPI_DDR    DDRB
+#define SPI_SS    4
+#define SPI_MOSI  5
+#define SPI_MISO  6
+#define SPI_SCK   7
+
+/* keyboard clock and data, the clock on a pin change interrupt */
+#define PS2_PORT   PORTC
+#define PS2_DDR    DDRC
+#define PS2_IN     PINC
+#define PS2_CLK   0
+#define PS2_DATA  1
+#define PS2_PCMSK  PCMSK2
+#define PS2_PCIE  PCIE2
+#define PS2_PCIF  PCIF2
+#define PS2_vect   PCINT2_vect
+
 #elif defined(__AVR_ATmega8__) || defined(__AVR_ATmega88__) || \
 defined(__AVR_ATmega168P__) || defined(__AVR_ATmega168__) || \
 defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__)
@@ -152,6 +366,33 @@ defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__)
 #define SYNC_DDR   DDRB
 #define SYNC_PIN  1
 
+/* input capture */
+#define ICP_IN     PINB
+#define ICP_PIN   0
+
+/* sound */
+#define SND_DDR    DDRB
+#define SND_PIN   3
+
+/* spi */
+#define SPI_PORT   PORTB
+#define SPI_DDR    DDRB
+#define SPI_SS    2
+#define SPI_MOSI  3
+#define SPI_MISO  4
+#define SPI_SCK   5
+
+/* keyboard clock and data, the clock on a pin change interrupt */
+#define PS2_PORT   PORTC
+#define PS2_DDR    DDRC
+#define PS2_IN     PINC
+#define PS2_CLK   0
+#define PS2_DATA  1
+#define PS2_PCMSK  PCMSK1
+#define PS2_PCIE  PCIE1
+#define PS2_PCIF  PCIF1
+#define PS2_vect   PCINT1_vect
+
 #elif defined (__AVR_AT90USB1286__)
 
 /* video */
@@ -164,6 +405,88 @@ defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__)
 #define SYNC_DDR   DDRB
 #define SYNC_PIN  5
 
+/* input capture */
+#define ICP_IN     PIND
+#define ICP_PIN   4
+
+/* sound */
+#define SND_DDR    DDRB
+#define SND_PIN   4
+
+/* spi */
+#define SPI_PORT   PORTB
+#define SPI_DDR    DDRB
+#define SPI_SS    0
+#define SPI_SCK   1
+#define SPI_MOSI  2
+#define SPI_MISO  3
+
+/* keyboard clock and data, the clock on a pin change interrupt */
+#define PS2_PORT   PORTB
+#define PS2_DDR    DDRB
+#define PS2_IN     PINB
+#define PS2_CLK   6
+#define PS2_DATA  7
+#define PS2_PCMSK  PCMSK0
+#define PS2_PCIE  PCIE0
+#define PS2_PCIF  PCIF0
+#define PS2_vect   PCINT0_vect
+
+#endif
+
+#if defined(ENABLE_GRAYSCALE) && defined(ENABLE_DISPLAY_LIST)
+#error "ENABLE_DISPLAY_LIST renders 1bpp rows only"
+#endif
+
+#if defined(ENABLE_TERMINAL) && \
+(defined(ENABLE_DISPLAY_LIST) || defined(ENABLE_GRAYSCALE) || HEIGHT % 8)
+#error "ENABLE_TERMINAL needs a 1bpp framebuffer with HEIGHT a multiple of 8"
+#endif
+
+#if defined(ENABLE_MIRROR)
+#if defined(ENABLE_DISPLAY_LIST) || defined(ENABLE_SPIRAM)
+#error "ENABLE_MIRROR sends the internal framebuffer"
+#elif defined(ENABLE_TERMINAL)
+#error "ENABLE_MIRROR and ENABLE_TERMINAL both use USART0"
+#endif
+#endif
+
+#if defined(ENABLE_3D) && defined(ENABLE_DISPLAY_LIST)
+#error "ENABLE_3D draws into the framebuffer"
+#endif
+
+#if defined(ENABLE_DEFERRED) && defined(ENABLE_DISPLAY_LIST)
+#error "ENABLE_DEFERRED draws into the framebuffer"
+#endif
+
+#if defined(ENABLE_REGIONS) && defined(ENABLE_DISPLAY_LIST)
+#error "ENABLE_REGIONS scans out a framebuffer"
+#endif
+
+#if defined(ENABLE_DIRTY) && defined(ENABLE_DISPLAY_LIST)
+#error "ENABLE_DIRTY tracks the rows of a framebuffer"
+#endif
+
+#if defined(ENABLE_GENLOCK) && defined(ENABLE_DISPLAY_LIST)
+#error "ENABLE_GENLOCK needs the line interrupt at the start of the line"
+#endif
+
+#if defined(ENABLE_SPIRAM)
+#if defined(ENABLE_GRAYSCALE) || defined(ENABLE_DISPLAY_LIST) || \
+defined(ENABLE_TERMINAL) || defined(ENABLE_DEFERRED)
+#error "ENABLE_SPIRAM has no internal framebuffer and streams 1bpp only"
+#elif defined(ENABLE_SOUND) && SND_PIN == SPI_MOSI
+/* both on port B */
+#error "OC2A is the MOSI pin on this device"
+#endif
+#endif
+
+#if defined(ENABLE_GRAYSCALE)
+#if !defined(ENABLE_FAST_OUTPUT) || VID_PIN != 7
+#error "ENABLE_GRAYSCALE needs ENABLE_FAST_OUTPUT and VID_PIN 7"
+#elif GMETHOD < 3
+#error "WIDTH too large for ENABLE_GRAYSCALE at this F_CPU"
+#endif
 #endif
 
 #if VID_PIN == 0
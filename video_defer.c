@@ -0,0 +1,303 @@
+#include "video.h"
+
+#if defined(ENABLE_DEFERRED)
+
+#define DQ_RECT    0
+#define DQ_LINE    1
+#define DQ_STRING  2
+#define DQ_BITMAP  3
+#define DQ_SHIFT   4
+
+typedef struct
+{
+	uint8_t type, color;
+	int16_t a, b, c, d;
+	void *p;
+} dq_cmd_t;
+
+extern volatile int scanLine;
+extern int stop_render, lines_frame;
+extern uint8_t start_render, video_color;
+extern uint16_t cycles_line;
+extern uint8_t clip_x0, clip_y0, clip_x1, clip_y1;
+extern int16_t draw_ox, draw_oy;
+
+/* single producer ring, the main loop only writes dq_head and the
+   line interrupt only writes dq_tail */
+static dq_cmd_t dq[DQ_SIZE];
+static volatile uint8_t dq_head, dq_tail;
+static volatile uint8_t dq_busy, dq_lines;
+
+static uint8_t dq_window(void)
+{
+	int line = scanLine;
+	return line < start_render - DQ_GUARD || line > stop_render;
+}
+
+/* lines left before the guard ahead of the active area */
+static int dq_left(void)
+{
+	int line = scanLine;
+	if(line > stop_render)
+	{
+		line -= lines_frame;
+	}
+
+	return start_render - DQ_GUARD - line;
+}
+
+/* rough lines a command takes: about 10 cycles per framebuffer byte
+   for spans and shifts, 20 per pixel for lines, text and bitmaps. At
+   most DQ_LINES, so a larger one still starts right after the active
+   area and only then may run into the next. */
+static uint8_t dq_cost(const dq_cmd_t *c)
+{
+	uint32_t cycles;
+	const char *s;
+	switch(c->type)
+	{
+		case DQ_RECT:
+		{
+			cycles = 10UL * abs(c->d - c->b) * (abs(c->c - c->a) / 8 + 2);
+			break;
+		}
+
+		case DQ_LINE:
+		{
+			cycles = 20UL * (abs(c->c - c->a) + abs(c->d - c->b) + 1);
+			break;
+		}
+
+		case DQ_STRING:
+		{
+			for(cycles = 0, s = c->p; *s; ++s)
+			{
+				cycles += 20UL * 35;
+			}
+
+			break;
+		}
+
+		case DQ_BITMAP:
+		{
+			cycles = 20UL * 8 * (uint16_t)c->d;
+			break;
+		}
+
+		default:
+		{
+			cycles = 10UL * WIDTH * HEIGHT;
+			break;
+		}
+	}
+
+	cycles = cycles / cycles_line + 1;
+	return cycles > DQ_LINES ? DQ_LINES : cycles;
+}
+
+static dq_cmd_t *dq_slot(uint8_t type)
+{
+	dq_cmd_t *c;
+	if(((dq_head + 1) & (DQ_SIZE - 1)) == dq_tail)
+	{
+		return 0;
+	}
+
+	c = &dq[dq_head];
+	c->type = type;
+	c->color = video_color;
+	return c;
+}
+
+static uint8_t dq_commit(void)
+{
+	/* the command is stored before the interrupt can see it */
+	__asm__ __volatile__("" ::: "memory");
+	dq_head = (dq_head + 1) & (DQ_SIZE - 1);
+	return 1;
+}
+
+/* commands always draw solid on the whole screen, the surface, clip,
+   origin and pattern the main loop has set are put back afterwards.
+   They are shared, so the main loop must not be inside a drawing call
+   of its own while commands are queued, see video.h. */
+static void dq_exec(dq_cmd_t *c)
+{
+	uint8_t color = video_color;
+	uint8_t x0 = clip_x0, y0 = clip_y0, x1 = clip_x1, y1 = clip_y1;
+	int16_t ox = draw_ox, oy = draw_oy;
+	video_surface_t *s = video_get_surface();
+#if !defined(ENABLE_GRAYSCALE)
+	const uint8_t *pat = video_get_pattern();
+	video_set_pattern(0);
+#endif
+	video_color = c->color;
+	video_set_surface(0);
+	switch(c->type)
+	{
+		case DQ_RECT:
+		{
+			video_rect(c->a, c->b, c->c, c->d);
+			break;
+		}
+
+		case DQ_LINE:
+		{
+			video_line(c->a, c->b, c->c, c->d);
+			break;
+		}
+
+		case DQ_STRING:
+		{
+			video_string(c->a, c->b, c->p);
+			break;
+		}
+
+		case DQ_BITMAP:
+		{
+			video_bitmap(c->p, c->a, c->b, c->c, c->d);
+			break;
+		}
+
+		case DQ_SHIFT:
+		{
+			video_shift(c->a, c->b);
+			break;
+		}
+	}
+
+	video_set_surface(s);
+#if !defined(ENABLE_GRAYSCALE)
+	video_set_pattern(pat);
+#endif
+	clip_x0 = x0;
+	clip_y0 = y0;
+	clip_x1 = x1;
+	clip_y1 = y1;
+	draw_ox = ox;
+	draw_oy = oy;
+	video_color = color;
+}
+
+uint8_t video_defer_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+	dq_cmd_t *c;
+	if(!(c = dq_slot(DQ_RECT)))
+	{
+		return 0;
+	}
+
+	c->a = x0;
+	c->b = y0;
+	c->c = x1;
+	c->d = y1;
+	return dq_commit();
+}
+
+uint8_t video_defer_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+	dq_cmd_t *c;
+	if(!(c = dq_slot(DQ_LINE)))
+	{
+		return 0;
+	}
+
+	c->a = x0;
+	c->b = y0;
+	c->c = x1;
+	c->d = y1;
+	return dq_commit();
+}
+
+/* the string is read when the command runs and must stay valid */
+uint8_t video_defer_string(uint8_t x, uint8_t y, char *s)
+{
+	dq_cmd_t *c;
+	if(!(c = dq_slot(DQ_STRING)))
+	{
+		return 0;
+	}
+
+	c->a = x;
+	c->b = y;
+	c->p = s;
+	return dq_commit();
+}
+
+uint8_t video_defer_bitmap
+(uint8_t *img, uint8_t x0, uint8_t y0, uint8_t x1, uint16_t len)
+{
+	dq_cmd_t *c;
+	if(!(c = dq_slot(DQ_BITMAP)))
+	{
+		return 0;
+	}
+
+	c->a = x0;
+	c->b = y0;
+	c->c = x1;
+	c->d = len;
+	c->p = img;
+	return dq_commit();
+}
+
+uint8_t video_defer_shift(uint8_t distance, uint8_t dir)
+{
+	dq_cmd_t *c;
+	if(!(c = dq_slot(DQ_SHIFT)))
+	{
+		return 0;
+	}
+
+	c->a = distance;
+	c->b = dir;
+	return dq_commit();
+}
+
+/* wait until every queued command has been drawn */
+void video_defer_flush(void)
+{
+	while(dq_tail != dq_head)
+	{
+	}
+}
+
+/* runs at the end of every line interrupt, drains the queue with
+   interrupts enabled while the beam is outside the active area and
+   the frame has DQ_LINES left. A command is never split and only
+   started while the lines it is estimated to take are left before
+   the active area; the estimate is not exact, so a command can still
+   run a little into it */
+void video_defer_run(void)
+{
+	if(!dq_window())
+	{
+		dq_lines = 0;
+		return;
+	}
+
+	if(dq_busy)
+	{
+		++dq_lines;
+		return;
+	}
+
+	if(dq_tail == dq_head || dq_lines >= DQ_LINES)
+	{
+		return;
+	}
+
+	dq_busy = 1;
+	sei();
+	while(dq_tail != dq_head && dq_lines < DQ_LINES && dq_window() &&
+		dq_cost(&dq[dq_tail]) <= dq_left())
+	{
+		dq_exec(&dq[dq_tail]);
+		dq_tail = (dq_tail + 1) & (DQ_SIZE - 1);
+	}
+
+	cli();
+	dq_busy = 0;
+}
+
+#endif /* ENABLE_DEFERRED */
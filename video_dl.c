@@ -0,0 +1,431 @@
+#include "video.h"
+
+#if defined(ENABLE_DISPLAY_LIST)
+
+#define DL_RECT    0
+#define DL_LINE    1
+#define DL_STRING  2
+#define DL_BITMAP  3
+
+typedef struct
+{
+	uint8_t type, color, x0, y0, x1, y1;
+	const void *data;
+
+	/* line cursor, restarted every frame */
+	uint8_t frame, cx, cy;
+	int8_t sx;
+	int16_t err, dx, dy;
+} dl_item_t;
+
+extern uint8_t video_color;
+
+static dl_item_t dl_items[DL_ITEMS];
+static volatile uint8_t dl_count;
+
+static uint8_t dl_buf[2][WIDTH];
+uint8_t *dl_front = dl_buf[0];
+static uint8_t * volatile dl_back = dl_buf[1];
+
+static volatile uint8_t dl_next_row, dl_pending, dl_busy;
+static uint8_t dl_step, dl_frame, dl_lines, dl_worst;
+static volatile uint16_t dl_overruns;
+
+static inline void dl_mask(uint8_t *p, uint8_t m, uint8_t color)
+{
+	switch(color)
+	{
+		case BLACK:
+		{
+			*p &= ~m;
+			break;
+		}
+
+		case WHITE:
+		{
+			*p |= m;
+			break;
+		}
+
+		case INVERT:
+		{
+			*p ^= m;
+			break;
+		}
+	}
+}
+
+/* x0 and x1 inclusive */
+static void dl_span(uint8_t *buf, uint8_t x0, uint8_t x1, uint8_t color)
+{
+	uint8_t *p, *e, lm, rm;
+	if(x1 >= PWIDTH)
+	{
+		x1 = PWIDTH - 1;
+	}
+
+	if(x0 > x1)
+	{
+		return;
+	}
+
+	p = buf + (x0 >> 3);
+	e = buf + (x1 >> 3);
+	lm = 0xFF >> (x0 & 7);
+	rm = 0xFF << (7 - (x1 & 7));
+	if(p == e)
+	{
+		dl_mask(p, lm & rm, color);
+		return;
+	}
+
+	dl_mask(p, lm, color);
+	for(++p; p < e; ++p)
+	{
+		dl_mask(p, 0xFF, color);
+	}
+
+	dl_mask(e, rm, color);
+}
+
+static void dl_line_step(dl_item_t *it)
+{
+	int16_t e2 = it->err;
+	if(e2 > -it->dx)
+	{
+		it->err -= it->dy;
+		it->cx += it->sx;
+	}
+
+	if(e2 < it->dy)
+	{
+		it->err += it->dx;
+		++it->cy;
+	}
+}
+
+static void dl_line_row(dl_item_t *it, uint8_t row, uint8_t *buf)
+{
+	uint8_t xa, xb;
+	if(it->frame != dl_frame)
+	{
+		it->frame = dl_frame;
+		it->cx = it->x0;
+		it->cy = it->y0;
+		it->err = (it->dx > it->dy ? it->dx : -it->dy) / 2;
+	}
+
+	/* rows skipped by the other field */
+	while(it->cy < row)
+	{
+		dl_line_step(it);
+	}
+
+	xa = xb = it->cx;
+	while(it->cy == row && (it->cx != it->x1 || it->cy != it->y1))
+	{
+		dl_line_step(it);
+		if(it->cy == row)
+		{
+			xb = it->cx;
+		}
+	}
+
+	if(xa > xb)
+	{
+		dl_span(buf, xb, xa, it->color);
+	}
+	else
+	{
+		dl_span(buf, xa, xb, it->color);
+	}
+}
+
+/* row of the text in font5x7, the rows of a glyph are merged like
+   those of a bitmap */
+static void dl_string_row(dl_item_t *it, uint8_t row, uint8_t *buf)
+{
+	video_font_t h;
+	uint8_t g, i, n, p, s, w, x, xb;
+	const char *t;
+	const uint8_t *v;
+	memcpy_P(&h, &font5x7, sizeof(h));
+	row -= it->y0;
+	for(t = it->data, x = it->x0; *t; ++t)
+	{
+		if((g = video_font_glyph(&h, *t)) == 0xFF)
+		{
+			continue;
+		}
+
+		w = pgm_read_byte(h.width + g);
+		n = (w + 7) >> 3;
+		v = h.bitmap + pgm_read_word(h.offset + g) + row * n;
+		s = x & 7;
+		for(i = 0, xb = x >> 3; i < n && xb < WIDTH; ++i, ++v, ++xb)
+		{
+			if((p = pgm_read_byte(v)))
+			{
+				dl_mask(buf + xb, p >> s, it->color);
+				if(s && xb + 1 < WIDTH)
+				{
+					dl_mask(buf + xb + 1, p << (8 - s), it->color);
+				}
+			}
+		}
+
+		if(x > 255 - w)
+		{
+			break;
+		}
+
+		x += w;
+	}
+}
+
+static void dl_bitmap_row(dl_item_t *it, uint8_t row, uint8_t *buf)
+{
+	uint8_t i, p, s, w, xb;
+	const uint8_t *v;
+	w = it->x1;
+	v = (const uint8_t *)it->data + (row - it->y0) * w;
+	s = it->x0 & 7;
+	xb = it->x0 >> 3;
+	for(i = 0; i < w && xb < WIDTH; ++i, ++v, ++xb)
+	{
+		p = pgm_read_byte(v);
+		dl_mask(buf + xb, p >> s, it->color);
+		if(s && xb + 1 < WIDTH)
+		{
+			dl_mask(buf + xb + 1, p << (8 - s), it->color);
+		}
+	}
+}
+
+static void dl_row(uint8_t row, uint8_t *buf)
+{
+	uint8_t i, n;
+	dl_item_t *it;
+	for(i = 0; i < WIDTH; ++i)
+	{
+		buf[i] = 0;
+	}
+
+	n = dl_count;
+	for(i = 0, it = dl_items; i < n && !dl_pending; ++i, ++it)
+	{
+		if(row < it->y0 || row > it->y1)
+		{
+			continue;
+		}
+
+		switch(it->type)
+		{
+			case DL_RECT:
+			{
+				dl_span(buf, it->x0, it->x1, it->color);
+				break;
+			}
+
+			case DL_LINE:
+			{
+				dl_line_row(it, row, buf);
+				break;
+			}
+
+			case DL_STRING:
+			{
+				dl_string_row(it, row, buf);
+				break;
+			}
+
+			case DL_BITMAP:
+			{
+				dl_bitmap_row(it, row, buf);
+				break;
+			}
+		}
+	}
+}
+
+static dl_item_t *dl_add(uint8_t type, uint8_t y0, uint8_t y1)
+{
+	dl_item_t *it;
+	if(dl_count >= DL_ITEMS || y0 > y1 || y0 >= HEIGHT)
+	{
+		return 0;
+	}
+
+	it = &dl_items[dl_count];
+	it->type = type;
+	it->color = video_color;
+	it->y0 = y0;
+	it->y1 = (y1 < HEIGHT) ? y1 : HEIGHT - 1;
+	it->frame = dl_frame - 1;
+	return it;
+}
+
+void video_dl_clear(void)
+{
+	dl_count = 0;
+}
+
+uint8_t video_dl_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+	dl_item_t *it;
+	if(x0 >= x1 || y0 >= y1 || !(it = dl_add(DL_RECT, y0, y1 - 1)))
+	{
+		return 0;
+	}
+
+	it->x0 = x0;
+	it->x1 = x1 - 1;
+	++dl_count;
+	return 1;
+}
+
+uint8_t video_dl_line(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+	uint8_t t;
+	dl_item_t *it;
+	if(y0 > y1)
+	{
+		t = x0; x0 = x1; x1 = t;
+		t = y0; y0 = y1; y1 = t;
+	}
+
+	if(x0 >= PWIDTH || x1 >= PWIDTH || y1 >= HEIGHT ||
+		!(it = dl_add(DL_LINE, y0, y1)))
+	{
+		return 0;
+	}
+
+	it->x0 = x0;
+	it->x1 = x1;
+	it->dx = abs(x1 - x0);
+	it->dy = y1 - y0;
+	it->sx = x0 < x1 ? 1 : -1;
+	++dl_count;
+	return 1;
+}
+
+/* the string is read every frame and must stay valid */
+uint8_t video_dl_string(uint8_t x, uint8_t y, char *s)
+{
+	dl_item_t *it;
+	uint8_t h = pgm_read_byte(&font5x7.height);
+	if(!(it = dl_add(DL_STRING, y, y + h - 1)))
+	{
+		return 0;
+	}
+
+	it->x0 = x;
+	it->data = s;
+	++dl_count;
+	return 1;
+}
+
+/* PROGMEM bitmap, row major, w bytes per row, h rows */
+uint8_t video_dl_bitmap
+(const uint8_t *img, uint8_t x, uint8_t y, uint8_t w, uint8_t h)
+{
+	dl_item_t *it;
+	if(!h || !(it = dl_add(DL_BITMAP, y, y + h - 1)))
+	{
+		return 0;
+	}
+
+	it->x0 = x;
+	it->x1 = w;
+	it->data = img;
+	++dl_count;
+	return 1;
+}
+
+/* rows that were not finished when they had to be shown */
+uint16_t video_dl_overruns(void)
+{
+	uint16_t n;
+	cli();
+	n = dl_overruns;
+	sei();
+	return n;
+}
+
+/* most scanlines a single row took to render */
+uint8_t video_dl_load(void)
+{
+	return dl_worst;
+}
+
+void video_dl_reset_stats(void)
+{
+	cli();
+	dl_overruns = 0;
+	dl_worst = 0;
+	sei();
+}
+
+/* called from blank_line some lines before the first row */
+void video_dl_start(uint8_t row, uint8_t step)
+{
+	++dl_frame;
+	dl_step = step;
+	dl_next_row = row;
+	dl_pending = 1;
+}
+
+/* called on every row advance, shows the rendered row and
+   queues the next one */
+void video_dl_next(void)
+{
+	uint8_t *t;
+	if(dl_busy)
+	{
+		++dl_overruns;
+	}
+
+	t = dl_front;
+	dl_front = dl_back;
+	dl_back = t;
+	if(dl_next_row + dl_step < HEIGHT)
+	{
+		dl_next_row += dl_step;
+		dl_pending = 1;
+	}
+}
+
+/* runs at the end of every line interrupt, renders with interrupts
+   enabled so the following lines preempt it */
+void video_dl_render(void)
+{
+	if(dl_busy)
+	{
+		++dl_lines;
+		return;
+	}
+
+	if(!dl_pending)
+	{
+		return;
+	}
+
+	dl_busy = 1;
+	dl_lines = 0;
+	sei();
+	do
+	{
+		dl_pending = 0;
+		dl_row(dl_next_row, dl_back);
+	}
+	while(dl_pending);
+	cli();
+	if(dl_lines > dl_worst)
+	{
+		dl_worst = dl_lines;
+	}
+
+	dl_busy = 0;
+}
+
+#endif /* ENABLE_DISPLAY_LIST */
@@ -1,106 +1,795 @@
-#include <avr/pgmspace.h>
+/* generated by tools/fontc from fonts/5x7.bdf, do not edit */
 
-const uint8_t font5x7[] PROGMEM =
-{
-	0x00, 0x00, 0x00, 0x00, 0x00, /*   */
-	0x00, 0x00, 0x5F, 0x00, 0x00, /* ! */
-	0x00, 0x07, 0x00, 0x07, 0x00, /* " */
-	0x14, 0x7F, 0x14, 0x7F, 0x14, /* # */
-	0x24, 0x2A, 0x7F, 0x2A, 0x12, /* $ */
-	0x23, 0x13, 0x08, 0x64, 0x62, /* % */
-	0x36, 0x49, 0x55, 0x22, 0x50, /* & */
-	0x00, 0x00, 0x03, 0x00, 0x00, /* ' */
-	0x00, 0x1C, 0x22, 0x41, 0x00, /* ( */
-	0x00, 0x41, 0x22, 0x1C, 0x00, /* ) */
-	0x14, 0x08, 0x3E, 0x08, 0x14, /* * */
-	0x08, 0x08, 0x3E, 0x08, 0x08, /* + */
-	0x00, 0x50, 0x30, 0x00, 0x00, /* , */
-	0x08, 0x08, 0x08, 0x08, 0x08, /* - */
-	0x00, 0x60, 0x60, 0x00, 0x00, /* . */
-	0x20, 0x10, 0x08, 0x04, 0x02, /* / */
-
-	0x3E, 0x51, 0x49, 0x45, 0x3E, /* 0 */
-	0x00, 0x42, 0x7F, 0x40, 0x00, /* 1 */
-	0x62, 0x51, 0x49, 0x49, 0x46, /* 2 */
-	0x22, 0x41, 0x49, 0x49, 0x36, /* 3 */
-	0x18, 0x14, 0x12, 0x7F, 0x10, /* 4 */
-	0x27, 0x45, 0x45, 0x45, 0x39, /* 5 */
-	0x3C, 0x4A, 0x49, 0x49, 0x30, /* 6 */
-	0x01, 0x71, 0x09, 0x05, 0x03, /* 7 */
-	0x36, 0x49, 0x49, 0x49, 0x36, /* 8 */
-	0x06, 0x49, 0x49, 0x29, 0x1E, /* 9 */
-
-	0x00, 0x36, 0x36, 0x00, 0x00, /* : */
-	0x00, 0x56, 0x36, 0x00, 0x00, /* ; */
-	0x08, 0x14, 0x22, 0x41, 0x00, /* < */
-	0x14, 0x14, 0x14, 0x14, 0x14, /* = */
-	0x00, 0x41, 0x22, 0x14, 0x08, /* > */
-	0x02, 0x01, 0x51, 0x09, 0x06, /* ? */
-	0x32, 0x49, 0x79, 0x41, 0x3E, /* @ */
+#include "video.h"
 
-	0x7C, 0x12, 0x11, 0x12, 0x7C, /* A */
-	0x41, 0x7F, 0x49, 0x49, 0x36, /* B */
-	0x3E, 0x41, 0x41, 0x41, 0x22, /* C */
-	0x41, 0x7F, 0x41, 0x41, 0x3E, /* D */
-	0x7F, 0x49, 0x49, 0x49, 0x41, /* E */
-	0x7F, 0x09, 0x09, 0x09, 0x01, /* F */
-	0x3E, 0x41, 0x41, 0x49, 0x7A, /* G */
-	0x7F, 0x08, 0x08, 0x08, 0x7F, /* H */
-	0x00, 0x41, 0x7F, 0x41, 0x00, /* I */
-	0x20, 0x40, 0x41, 0x3F, 0x01, /* J */
-	0x7F, 0x08, 0x14, 0x22, 0x41, /* K */
-	0x7F, 0x40, 0x40, 0x40, 0x40, /* L */
-	0x7F, 0x02, 0x0C, 0x02, 0x7F, /* M */
-	0x7F, 0x04, 0x08, 0x10, 0x7F, /* N */
-	0x3E, 0x41, 0x41, 0x41, 0x3E, /* O */
-	0x7F, 0x09, 0x09, 0x09, 0x06, /* P */
-	0x3E, 0x41, 0x51, 0x21, 0x5E, /* Q */
-	0x7F, 0x09, 0x19, 0x29, 0x46, /* R */
-	0x26, 0x49, 0x49, 0x49, 0x32, /* S */
-	0x01, 0x01, 0x7F, 0x01, 0x01, /* T */
-	0x3F, 0x40, 0x40, 0x40, 0x3F, /* U */
-	0x1F, 0x20, 0x40, 0x20, 0x1F, /* V */
-	0x3F, 0x40, 0x38, 0x40, 0x3F, /* W */
-	0x63, 0x14, 0x08, 0x14, 0x63, /* X */
-	0x07, 0x08, 0x70, 0x08, 0x07, /* Y */
-	0x61, 0x51, 0x49, 0x45, 0x43, /* Z */
+static const uint8_t font5x7_width[] PROGMEM =
+{
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,
+	6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6
+};
 
-	0x00, 0x7F, 0x41, 0x41, 0x00, /* [ */
-	0x02, 0x04, 0x08, 0x10, 0x20, /* \ */
-	0x00, 0x41, 0x41, 0x7F, 0x00, /* ] */
-	0x04, 0x02, 0x01, 0x02, 0x04, /* ^ */
-	0x40, 0x40, 0x40, 0x40, 0x40, /* _ */
-	0x00, 0x01, 0x02, 0x04, 0x00, /* ` */
+static const uint16_t font5x7_offset[] PROGMEM =
+{
+	0, 8, 16, 24, 32, 40, 48, 56, 64, 72, 80, 88,
+	96, 104, 112, 120, 128, 136, 144, 152, 160, 168, 176, 184,
+	192, 200, 208, 216, 224, 232, 240, 248, 256, 264, 272, 280,
+	288, 296, 304, 312, 320, 328, 336, 344, 352, 360, 368, 376,
+	384, 392, 400, 408, 416, 424, 432, 440, 448, 456, 464, 472,
+	480, 488, 496, 504, 512, 520, 528, 536, 544, 552, 560, 568,
+	576, 584, 592, 600, 608, 616, 624, 632, 640, 648, 656, 664,
+	672, 680, 688, 696, 704, 712, 720, 728, 736, 744, 752
+};
 
-	0x20, 0x54, 0x54, 0x54, 0x78, /* a */
-	0x7F, 0x48, 0x44, 0x44, 0x38, /* b */
-	0x38, 0x44, 0x44, 0x44, 0x20, /* c */
-	0x38, 0x44, 0x44, 0x48, 0x7F, /* d */
-	0x38, 0x54, 0x54, 0x54, 0x18, /* e */
-	0x08, 0x7E, 0x09, 0x01, 0x02, /* f */
-	0x08, 0x54, 0x54, 0x54, 0x3C, /* g */
-	0x7F, 0x08, 0x04, 0x04, 0x78, /* h */
-	0x00, 0x48, 0x7D, 0x40, 0x00, /* i */
-	0x20, 0x40, 0x44, 0x3D, 0x00, /* j */
-	0x7F, 0x10, 0x28, 0x44, 0x00, /* k */
-	0x00, 0x41, 0x7F, 0x40, 0x00, /* l */
-	0x7C, 0x04, 0x78, 0x04, 0x78, /* m */
-	0x7C, 0x08, 0x04, 0x04, 0x78, /* n */
-	0x38, 0x44, 0x44, 0x44, 0x38, /* o */
-	0x7C, 0x14, 0x14, 0x14, 0x08, /* p */
-	0x08, 0x14, 0x14, 0x18, 0x7C, /* q */
-	0x7C, 0x08, 0x04, 0x04, 0x08, /* r */
-	0x48, 0x54, 0x54, 0x54, 0x20, /* s */
-	0x04, 0x3F, 0x44, 0x40, 0x20, /* t */
-	0x3C, 0x40, 0x40, 0x20, 0x7C, /* u */
-	0x1C, 0x20, 0x40, 0x20, 0x1C, /* v */
-	0x3C, 0x40, 0x30, 0x40, 0x3C, /* w */
-	0x44, 0x28, 0x10, 0x28, 0x44, /* x */
-	0x0C, 0x50, 0x50, 0x50, 0x3C, /* y */
-	0x44, 0x64, 0x54, 0x4C, 0x44, /* z */
+static const uint8_t font5x7_bitmap[] PROGMEM =
+{
+	0x00, /*   */
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x20, /* ! */
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x00,
+	0x20,
+	0x00,
+	0x50, /* " */
+	0x50,
+	0x50,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x50, /* # */
+	0x50,
+	0xF8,
+	0x50,
+	0xF8,
+	0x50,
+	0x50,
+	0x00,
+	0x20, /* $ */
+	0x78,
+	0xA0,
+	0x70,
+	0x28,
+	0xF0,
+	0x20,
+	0x00,
+	0xC0, /* % */
+	0xC8,
+	0x10,
+	0x20,
+	0x40,
+	0x98,
+	0x18,
+	0x00,
+	0x60, /* & */
+	0x90,
+	0xA0,
+	0x40,
+	0xA8,
+	0x90,
+	0x68,
+	0x00,
+	0x20, /* ' */
+	0x20,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x10, /* ( */
+	0x20,
+	0x40,
+	0x40,
+	0x40,
+	0x20,
+	0x10,
+	0x00,
+	0x40, /* ) */
+	0x20,
+	0x10,
+	0x10,
+	0x10,
+	0x20,
+	0x40,
+	0x00,
+	0x00, /* * */
+	0x20,
+	0xA8,
+	0x70,
+	0xA8,
+	0x20,
+	0x00,
+	0x00,
+	0x00, /* + */
+	0x20,
+	0x20,
+	0xF8,
+	0x20,
+	0x20,
+	0x00,
+	0x00,
+	0x00, /* , */
+	0x00,
+	0x00,
+	0x00,
+	0x60,
+	0x20,
+	0x40,
+	0x00,
+	0x00, /* - */
+	0x00,
+	0x00,
+	0xF8,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00, /* . */
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x60,
+	0x60,
+	0x00,
+	0x00, /* / */
+	0x08,
+	0x10,
+	0x20,
+	0x40,
+	0x80,
+	0x00,
+	0x00,
+	0x70, /* 0 */
+	0x88,
+	0x98,
+	0xA8,
+	0xC8,
+	0x88,
+	0x70,
+	0x00,
+	0x20, /* 1 */
+	0x60,
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x70,
+	0x00,
+	0x70, /* 2 */
+	0x88,
+	0x08,
+	0x30,
+	0x40,
+	0x80,
+	0xF8,
+	0x00,
+	0x70, /* 3 */
+	0x88,
+	0x08,
+	0x30,
+	0x08,
+	0x88,
+	0x70,
+	0x00,
+	0x10, /* 4 */
+	0x30,
+	0x50,
+	0x90,
+	0xF8,
+	0x10,
+	0x10,
+	0x00,
+	0xF8, /* 5 */
+	0x80,
+	0xF0,
+	0x08,
+	0x08,
+	0x88,
+	0x70,
+	0x00,
+	0x30, /* 6 */
+	0x40,
+	0x80,
+	0xF0,
+	0x88,
+	0x88,
+	0x70,
+	0x00,
+	0xF8, /* 7 */
+	0x08,
+	0x10,
+	0x20,
+	0x40,
+	0x40,
+	0x40,
+	0x00,
+	0x70, /* 8 */
+	0x88,
+	0x88,
+	0x70,
+	0x88,
+	0x88,
+	0x70,
+	0x00,
+	0x70, /* 9 */
+	0x88,
+	0x88,
+	0x78,
+	0x08,
+	0x10,
+	0x60,
+	0x00,
+	0x00, /* : */
+	0x60,
+	0x60,
+	0x00,
+	0x60,
+	0x60,
+	0x00,
+	0x00,
+	0x00, /* ; */
+	0x60,
+	0x60,
+	0x00,
+	0x60,
+	0x20,
+	0x40,
+	0x00,
+	0x10, /* < */
+	0x20,
+	0x40,
+	0x80,
+	0x40,
+	0x20,
+	0x10,
+	0x00,
+	0x00, /* = */
+	0x00,
+	0xF8,
+	0x00,
+	0xF8,
+	0x00,
+	0x00,
+	0x00,
+	0x40, /* > */
+	0x20,
+	0x10,
+	0x08,
+	0x10,
+	0x20,
+	0x40,
+	0x00,
+	0x70, /* ? */
+	0x88,
+	0x08,
+	0x10,
+	0x20,
+	0x00,
+	0x20,
+	0x00,
+	0x70, /* @ */
+	0x88,
+	0x08,
+	0x68,
+	0xA8,
+	0xA8,
+	0x70,
+	0x00,
+	0x20, /* A */
+	0x50,
+	0x88,
+	0x88,
+	0xF8,
+	0x88,
+	0x88,
+	0x00,
+	0xF0, /* B */
+	0x48,
+	0x48,
+	0x70,
+	0x48,
+	0x48,
+	0xF0,
+	0x00,
+	0x70, /* C */
+	0x88,
+	0x80,
+	0x80,
+	0x80,
+	0x88,
+	0x70,
+	0x00,
+	0xF0, /* D */
+	0x48,
+	0x48,
+	0x48,
+	0x48,
+	0x48,
+	0xF0,
+	0x00,
+	0xF8, /* E */
+	0x80,
+	0x80,
+	0xF0,
+	0x80,
+	0x80,
+	0xF8,
+	0x00,
+	0xF8, /* F */
+	0x80,
+	0x80,
+	0xF0,
+	0x80,
+	0x80,
+	0x80,
+	0x00,
+	0x70, /* G */
+	0x88,
+	0x80,
+	0x98,
+	0x88,
+	0x88,
+	0x78,
+	0x00,
+	0x88, /* H */
+	0x88,
+	0x88,
+	0xF8,
+	0x88,
+	0x88,
+	0x88,
+	0x00,
+	0x70, /* I */
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x70,
+	0x00,
+	0x38, /* J */
+	0x10,
+	0x10,
+	0x10,
+	0x10,
+	0x90,
+	0x60,
+	0x00,
+	0x88, /* K */
+	0x90,
+	0xA0,
+	0xC0,
+	0xA0,
+	0x90,
+	0x88,
+	0x00,
+	0x80, /* L */
+	0x80,
+	0x80,
+	0x80,
+	0x80,
+	0x80,
+	0xF8,
+	0x00,
+	0x88, /* M */
+	0xD8,
+	0xA8,
+	0xA8,
+	0x88,
+	0x88,
+	0x88,
+	0x00,
+	0x88, /* N */
+	0x88,
+	0xC8,
+	0xA8,
+	0x98,
+	0x88,
+	0x88,
+	0x00,
+	0x70, /* O */
+	0x88,
+	0x88,
+	0x88,
+	0x88,
+	0x88,
+	0x70,
+	0x00,
+	0xF0, /* P */
+	0x88,
+	0x88,
+	0xF0,
+	0x80,
+	0x80,
+	0x80,
+	0x00,
+	0x70, /* Q */
+	0x88,
+	0x88,
+	0x88,
+	0xA8,
+	0x90,
+	0x68,
+	0x00,
+	0xF0, /* R */
+	0x88,
+	0x88,
+	0xF0,
+	0xA0,
+	0x90,
+	0x88,
+	0x00,
+	0x70, /* S */
+	0x88,
+	0x80,
+	0x70,
+	0x08,
+	0x88,
+	0x70,
+	0x00,
+	0xF8, /* T */
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x00,
+	0x88, /* U */
+	0x88,
+	0x88,
+	0x88,
+	0x88,
+	0x88,
+	0x70,
+	0x00,
+	0x88, /* V */
+	0x88,
+	0x88,
+	0x88,
+	0x88,
+	0x50,
+	0x20,
+	0x00,
+	0x88, /* W */
+	0x88,
+	0x88,
+	0xA8,
+	0xA8,
+	0xA8,
+	0x50,
+	0x00,
+	0x88, /* X */
+	0x88,
+	0x50,
+	0x20,
+	0x50,
+	0x88,
+	0x88,
+	0x00,
+	0x88, /* Y */
+	0x88,
+	0x88,
+	0x50,
+	0x20,
+	0x20,
+	0x20,
+	0x00,
+	0xF8, /* Z */
+	0x08,
+	0x10,
+	0x20,
+	0x40,
+	0x80,
+	0xF8,
+	0x00,
+	0x70, /* [ */
+	0x40,
+	0x40,
+	0x40,
+	0x40,
+	0x40,
+	0x70,
+	0x00,
+	0x00, /* \ */
+	0x80,
+	0x40,
+	0x20,
+	0x10,
+	0x08,
+	0x00,
+	0x00,
+	0x70, /* ] */
+	0x10,
+	0x10,
+	0x10,
+	0x10,
+	0x10,
+	0x70,
+	0x00,
+	0x20, /* ^ */
+	0x50,
+	0x88,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00, /* _ */
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0xF8,
+	0x00,
+	0x40, /* ` */
+	0x20,
+	0x10,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00,
+	0x00, /* a */
+	0x00,
+	0x70,
+	0x08,
+	0x78,
+	0x88,
+	0x78,
+	0x00,
+	0x80, /* b */
+	0x80,
+	0xB0,
+	0xC8,
+	0x88,
+	0x88,
+	0xF0,
+	0x00,
+	0x00, /* c */
+	0x00,
+	0x70,
+	0x80,
+	0x80,
+	0x88,
+	0x70,
+	0x00,
+	0x08, /* d */
+	0x08,
+	0x68,
+	0x98,
+	0x88,
+	0x88,
+	0x78,
+	0x00,
+	0x00, /* e */
+	0x00,
+	0x70,
+	0x88,
+	0xF8,
+	0x80,
+	0x70,
+	0x00,
+	0x30, /* f */
+	0x48,
+	0x40,
+	0xE0,
+	0x40,
+	0x40,
+	0x40,
+	0x00,
+	0x00, /* g */
+	0x00,
+	0x78,
+	0x88,
+	0x78,
+	0x08,
+	0x70,
+	0x00,
+	0x80, /* h */
+	0x80,
+	0xB0,
+	0xC8,
+	0x88,
+	0x88,
+	0x88,
+	0x00,
+	0x20, /* i */
+	0x00,
+	0x20,
+	0x60,
+	0x20,
+	0x20,
+	0x70,
+	0x00,
+	0x10, /* j */
+	0x00,
+	0x30,
+	0x10,
+	0x10,
+	0x90,
+	0x60,
+	0x00,
+	0x80, /* k */
+	0x80,
+	0x90,
+	0xA0,
+	0xC0,
+	0xA0,
+	0x90,
+	0x00,
+	0x60, /* l */
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x70,
+	0x00,
+	0x00, /* m */
+	0x00,
+	0xD0,
+	0xA8,
+	0xA8,
+	0xA8,
+	0xA8,
+	0x00,
+	0x00, /* n */
+	0x00,
+	0xB0,
+	0xC8,
+	0x88,
+	0x88,
+	0x88,
+	0x00,
+	0x00, /* o */
+	0x00,
+	0x70,
+	0x88,
+	0x88,
+	0x88,
+	0x70,
+	0x00,
+	0x00, /* p */
+	0x00,
+	0xF0,
+	0x88,
+	0xF0,
+	0x80,
+	0x80,
+	0x00,
+	0x00, /* q */
+	0x00,
+	0x68,
+	0x98,
+	0x78,
+	0x08,
+	0x08,
+	0x00,
+	0x00, /* r */
+	0x00,
+	0xB0,
+	0xC8,
+	0x80,
+	0x80,
+	0x80,
+	0x00,
+	0x00, /* s */
+	0x00,
+	0x70,
+	0x80,
+	0x70,
+	0x08,
+	0xF0,
+	0x00,
+	0x40, /* t */
+	0x40,
+	0xE0,
+	0x40,
+	0x40,
+	0x48,
+	0x30,
+	0x00,
+	0x00, /* u */
+	0x00,
+	0x88,
+	0x88,
+	0x88,
+	0x98,
+	0x68,
+	0x00,
+	0x00, /* v */
+	0x00,
+	0x88,
+	0x88,
+	0x88,
+	0x50,
+	0x20,
+	0x00,
+	0x00, /* w */
+	0x00,
+	0x88,
+	0x88,
+	0xA8,
+	0xA8,
+	0x50,
+	0x00,
+	0x00, /* x */
+	0x00,
+	0x88,
+	0x50,
+	0x20,
+	0x50,
+	0x88,
+	0x00,
+	0x00, /* y */
+	0x00,
+	0x88,
+	0x88,
+	0x78,
+	0x08,
+	0x70,
+	0x00,
+	0x00, /* z */
+	0x00,
+	0xF8,
+	0x10,
+	0x20,
+	0x40,
+	0xF8,
+	0x00,
+	0x10, /* { */
+	0x20,
+	0x20,
+	0x40,
+	0x20,
+	0x20,
+	0x10,
+	0x00,
+	0x20, /* | */
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x20,
+	0x00,
+	0x40, /* } */
+	0x20,
+	0x20,
+	0x10,
+	0x20,
+	0x20,
+	0x40,
+	0x00,
+	0x00, /* ~ */
+	0x00,
+	0x00,
+	0x68,
+	0x90,
+	0x00,
+	0x00,
+	0x00,
+};
 
-	0x00, 0x08, 0x36, 0x41, 0x00, /* { */
-	0x00, 0x00, 0x7F, 0x00, 0x00, /* | */
-	0x00, 0x41, 0x36, 0x08, 0x00, /* } */
-	0x10, 0x08, 0x08, 0x10, 0x08  /* ~ */
+const video_font_t font5x7 PROGMEM =
+{
+	8, 32, 126,
+	0, font5x7_width, font5x7_offset, font5x7_bitmap
 };
@@ -0,0 +1,658 @@
+#include "video.h"
+
+#if defined(ENABLE_SPIRAM)
+
+#define SR_READ   0x03
+#define SR_WRITE  0x02
+#define SR_WRMR   0x01
+#define SR_SEQ    0x40
+
+#define SR_SELECT   (SPI_PORT &= ~(1 << SPI_SS))
+#define SR_DESELECT (SPI_PORT |= (1 << SPI_SS))
+
+extern uint8_t video_color;
+extern uint8_t clip_x0, clip_y0, clip_x1, clip_y1;
+extern int16_t draw_ox, draw_oy;
+
+/* page base addresses, sr_shown is latched at the start of a field */
+static uint32_t sr_draw, sr_show, sr_shown;
+
+/* sr_hold: the scanout owns the bus from the start of the active area
+   to its end, sr_lock: the main loop is in a transaction, sr_abort:
+   the scanout took the bus while it was */
+static volatile uint8_t sr_hold, sr_lock, sr_abort;
+
+/* pixels of one row collected by the primitives, written with a single
+   read-modify-write of the bytes sr_lo to sr_hi */
+static uint8_t sr_buf[WIDTH], sr_mask[WIDTH];
+static uint8_t sr_y = 0xFF, sr_lo = 0xFF, sr_hi;
+
+static void sr_put(uint8_t b)
+{
+	SPDR = b;
+	while(!(SPSR & (1 << SPIF)))
+	{
+	}
+}
+
+/* selects the SRAM and sends the read of a row, the transfer of its
+   first byte is left running for the pixel output */
+static void sr_cmd(uint16_t offset)
+{
+	uint32_t a = sr_shown + offset;
+	SR_SELECT;
+	sr_put(SR_READ);
+	sr_put(a >> 16);
+	sr_put(a >> 8);
+	sr_put(a);
+	SPDR = 0;
+}
+
+void video_spi_begin(void)
+{
+	SPI_PORT |= (1 << SPI_SS);
+	SPI_DDR |= (1 << SPI_SS) | (1 << SPI_SCK) | (1 << SPI_MOSI);
+	SPI_DDR &= ~(1 << SPI_MISO);
+	SPCR = (1 << SPE) | (1 << MSTR);
+	SPSR = (1 << SPI2X);
+
+	SR_SELECT;
+	sr_put(SR_WRMR);
+	sr_put(SR_SEQ);
+	SR_DESELECT;
+}
+
+/* from blank_line the line before the active area, takes the bus
+   even if the main loop is in the middle of a transaction */
+void video_spi_start(uint16_t offset)
+{
+	uint8_t n = 4;
+	if(sr_lock)
+	{
+		SR_DESELECT;
+		sr_abort = 1;
+
+		/* let a byte it started finish, 16 cycles at F_CPU / 2. SPIF
+		   never comes if none was running, so the wait is bounded */
+		while(!(SPSR & (1 << SPIF)) && --n)
+		{
+		}
+	}
+
+	(void)SPSR;
+	(void)SPDR;
+	sr_hold = 1;
+	sr_shown = sr_show;
+	sr_cmd(offset);
+}
+
+/* from active_line after the pixels, the last one started the transfer
+   of a byte past the row */
+void video_spi_next(uint16_t offset)
+{
+	while(!(SPSR & (1 << SPIF)))
+	{
+	}
+
+	(void)SPDR;
+	SR_DESELECT;
+	sr_cmd(offset);
+}
+
+void video_spi_stop(void)
+{
+	while(!(SPSR & (1 << SPIF)))
+	{
+	}
+
+	(void)SPDR;
+	SR_DESELECT;
+	sr_hold = 0;
+}
+
+void video_spi_page(uint8_t draw, uint8_t show)
+{
+	uint32_t d = (uint32_t)draw * (WIDTH * HEIGHT);
+	uint32_t s = (uint32_t)show * (WIDTH * HEIGHT);
+	if(draw >= SPIRAM_PAGES || show >= SPIRAM_PAGES)
+	{
+		return;
+	}
+
+	sr_draw = d;
+	cli();
+	sr_show = s;
+	sei();
+}
+
+/* stops touching SPDR as soon as the scanout has taken the bus,
+   it holds CS low for its own read */
+static uint8_t sr_xfer(uint8_t b)
+{
+	cli();
+	if(sr_abort)
+	{
+		sei();
+		return 0;
+	}
+
+	SPDR = b;
+	sei();
+	while(!(SPSR & (1 << SPIF)) && !sr_abort)
+	{
+	}
+
+	return SPDR;
+}
+
+/* waits for the blanking, the bus is not given to the main loop
+   during the active area */
+static void sr_begin(uint8_t cmd, uint16_t offset)
+{
+	uint32_t a = sr_draw + offset;
+	for(;;)
+	{
+		while(sr_hold)
+		{
+		}
+
+		cli();
+		if(!sr_hold)
+		{
+			break;
+		}
+
+		sei();
+	}
+
+	sr_abort = 0;
+	sr_lock = 1;
+	SR_SELECT;
+	sei();
+	sr_xfer(cmd);
+	sr_xfer(a >> 16);
+	sr_xfer(a >> 8);
+	sr_xfer(a);
+}
+
+/* returns 0 if the transaction was cut off and has to be repeated */
+static uint8_t sr_end(void)
+{
+	uint8_t ok;
+	cli();
+	ok = !sr_abort;
+	if(ok)
+	{
+		SR_DESELECT;
+	}
+
+	sr_lock = 0;
+	sei();
+	return ok;
+}
+
+/* transactions never exceed a row, so they fit in the blanking */
+static void sr_read(uint16_t offset, uint8_t *buf, uint8_t n)
+{
+	uint8_t i;
+	do
+	{
+		sr_begin(SR_READ, offset);
+		for(i = 0; i < n; ++i)
+		{
+			buf[i] = sr_xfer(0);
+		}
+	}
+	while(!sr_end());
+}
+
+static void sr_write(uint16_t offset, const uint8_t *buf, uint8_t n)
+{
+	uint8_t i;
+	do
+	{
+		sr_begin(SR_WRITE, offset);
+		for(i = 0; i < n; ++i)
+		{
+			sr_xfer(buf[i]);
+		}
+	}
+	while(!sr_end());
+}
+
+static void sr_fill(uint16_t offset, uint8_t val, uint8_t n)
+{
+	uint8_t i;
+	do
+	{
+		sr_begin(SR_WRITE, offset);
+		for(i = 0; i < n; ++i)
+		{
+			sr_xfer(val);
+		}
+	}
+	while(!sr_end());
+}
+
+static void sr_flush(void)
+{
+	uint8_t i, n, *p, *m, full = 1;
+	uint16_t offset;
+	if(sr_lo <= sr_hi)
+	{
+		n = sr_hi - sr_lo + 1;
+		offset = sr_y * WIDTH + sr_lo;
+		m = sr_mask + sr_lo;
+
+		/* whole bytes of a solid color need no read */
+		for(i = 0; i < n; ++i)
+		{
+			if(m[i] != 0xFF)
+			{
+				full = 0;
+			}
+		}
+
+		if(!full || video_color == INVERT)
+		{
+			sr_read(offset, sr_buf, n);
+		}
+
+		for(i = 0, p = sr_buf; i < n; ++i, ++p, ++m)
+		{
+			switch(video_color)
+			{
+				case BLACK:
+				{
+					*p &= ~*m;
+					break;
+				}
+
+				case WHITE:
+				{
+					*p |= *m;
+					break;
+				}
+
+				case INVERT:
+				{
+					*p ^= *m;
+					break;
+				}
+			}
+
+			*m = 0;
+		}
+
+		sr_write(offset, sr_buf, n);
+	}
+
+	sr_y = 0xFF;
+	sr_lo = 0xFF;
+	sr_hi = 0;
+}
+
+static void sr_row(uint8_t y, uint8_t b0, uint8_t b1)
+{
+	if(y != sr_y)
+	{
+		sr_flush();
+		sr_y = y;
+	}
+
+	if(b0 < sr_lo)
+	{
+		sr_lo = b0;
+	}
+
+	if(b1 > sr_hi)
+	{
+		sr_hi = b1;
+	}
+}
+
+static void sr_plot(uint8_t x, uint8_t y)
+{
+	sr_row(y, x >> 3, x >> 3);
+	sr_mask[x >> 3] |= 0x80 >> (x & 7);
+}
+
+/* x0 and x1 inclusive */
+static void sr_span(uint8_t x0, uint8_t x1, uint8_t y)
+{
+	uint8_t *p, *e;
+	sr_row(y, x0 >> 3, x1 >> 3);
+	p = sr_mask + (x0 >> 3);
+	e = sr_mask + (x1 >> 3);
+	if(p == e)
+	{
+		*p |= (0xFF >> (x0 & 7)) & (0xFF << (7 - (x1 & 7)));
+		return;
+	}
+
+	*p |= 0xFF >> (x0 & 7);
+	for(++p; p < e; ++p)
+	{
+		*p = 0xFF;
+	}
+
+	*e |= 0xFF << (7 - (x1 & 7));
+}
+
+void video_sp(uint8_t x, uint8_t y)
+{
+	sr_plot(x, y);
+	sr_flush();
+}
+
+/* plots unchecked if the primitive is fully inside the clip */
+static void sr_clip_plot(uint8_t c, int16_t x, int16_t y)
+{
+	if(c == CLIP_IN || !video_clip_code(x, y))
+	{
+		sr_plot(x, y);
+	}
+}
+
+void video_set_pixel(uint8_t x, uint8_t y)
+{
+	sr_clip_plot(CLIP_PART, x + draw_ox, y + draw_oy);
+	sr_flush();
+#if defined(ENABLE_DIRTY)
+	video_dirty_clip(y + draw_oy, y + draw_oy + 1);
+#endif
+}
+
+uint8_t video_get_pixel(uint8_t x, uint8_t y)
+{
+	uint8_t b;
+	int16_t ax = x + draw_ox, ay = y + draw_oy;
+	if(video_clip_code(ax, ay))
+	{
+		return 0;
+	}
+
+	sr_read(ay * WIDTH + ax / 8, &b, 1);
+	return !!(b & (0x80 >> (ax & 7)));
+}
+
+/* fills the clip rectangle, whole rows at once if it is not clipped */
+void video_clear(void)
+{
+	uint8_t y, i;
+	uint16_t offset;
+#if defined(ENABLE_DIRTY)
+	video_dirty_clip(clip_y0, clip_y1);
+#endif
+	if(clip_x0 || clip_y0 || clip_x1 < PWIDTH || clip_y1 < HEIGHT)
+	{
+		for(y = clip_y0; clip_x0 < clip_x1 && y < clip_y1; ++y)
+		{
+			sr_span(clip_x0, clip_x1 - 1, y);
+		}
+
+		sr_flush();
+		return;
+	}
+
+	for(y = 0, offset = 0; y < HEIGHT; ++y, offset += WIDTH)
+	{
+		switch(video_color)
+		{
+			case BLACK:
+			{
+				sr_fill(offset, 0x00, WIDTH);
+				break;
+			}
+
+			case WHITE:
+			{
+				sr_fill(offset, 0xFF, WIDTH);
+				break;
+			}
+
+			case INVERT:
+			{
+				sr_read(offset, sr_buf, WIDTH);
+				for(i = 0; i < WIDTH; ++i)
+				{
+					sr_buf[i] = ~sr_buf[i];
+				}
+
+				sr_write(offset, sr_buf, WIDTH);
+				break;
+			}
+		}
+	}
+}
+
+void video_rect(uint8_t x0, uint8_t y0, uint8_t x1, uint8_t y1)
+{
+	int16_t ax0 = x0, ay0 = y0, ax1 = x1, ay1 = y1;
+	if(!video_clip(&ax0, &ay0, &ax1, &ay1))
+	{
+		return;
+	}
+
+	for(; ay0 < ay1; ++ay0)
+	{
+		sr_span(ax0, ax1 - 1, ay0);
+	}
+
+	sr_flush();
+}
+
+static void sr_circle_pair(uint8_t c, int16_t xa, int16_t xb, int16_t y)
+{
+	sr_clip_plot(c, xa, y);
+	if(xb != xa)
+	{
+		sr_clip_plot(c, xb, y);
+	}
+}
+
+/* the two points on each row go out in one write */
+void video_circle(int16_t x0, int16_t y0, int16_t radius)
+{
+	int16_t x = radius - 1, y = 0, dx = 1, dy = 1,
+	err = dx - (radius << 1);
+	int16_t bx0 = x0 - radius, by0 = y0 - radius,
+	bx1 = x0 + radius + 1, by1 = y0 + radius + 1;
+	uint8_t c;
+	if(!(c = video_clip(&bx0, &by0, &bx1, &by1)))
+	{
+		return;
+	}
+
+	x0 += draw_ox;
+	y0 += draw_oy;
+	while(x >= y)
+	{
+		sr_circle_pair(c, x0 - x, x0 + x, y0 + y);
+		sr_circle_pair(c, x0 - y, x0 + y, y0 + x);
+		sr_circle_pair(c, x0 - x, x0 + x, y0 - y);
+		sr_circle_pair(c, x0 - y, x0 + y, y0 - x);
+
+		if(err <= 0)
+		{
+			++y;
+			err += dy;
+			dy += 2;
+		}
+
+		if(err > 0)
+		{
+			--x;
+			dx += 2;
+			err += dx - (radius << 1);
+		}
+	}
+
+	sr_flush();
+}
+
+void video_hline(uint8_t x, uint8_t y, uint8_t l)
+{
+	int16_t x0 = x, y0 = y, x1 = x + l, y1 = y + 1;
+	if(video_clip(&x0, &y0, &x1, &y1))
+	{
+		sr_span(x0, x1 - 1, y0);
+		sr_flush();
+	}
+}
+
+void video_vline(uint8_t x, uint8_t y, uint8_t l)
+{
+	int16_t x0 = x, y0 = y, x1 = x + 1, y1 = y + l;
+	if(video_clip(&x0, &y0, &x1, &y1))
+	{
+		for(; y0 < y1; ++y0)
+		{
+			sr_plot(x0, y0);
+		}
+
+		sr_flush();
+	}
+}
+
+/* the pixels a line leaves on a row are written together, lines with
+   both ends in the clip rectangle are not checked per pixel */
+void video_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+	int16_t dx, dy, sx, sy, err, e2;
+	uint8_t ca, cb, c;
+	x0 += draw_ox;
+	y0 += draw_oy;
+	x1 += draw_ox;
+	y1 += draw_oy;
+	ca = video_clip_code(x0, y0);
+	cb = video_clip_code(x1, y1);
+	if(ca & cb)
+	{
+		return;
+	}
+
+#if defined(ENABLE_DIRTY)
+	video_dirty_clip(y0 < y1 ? y0 : y1, (y0 < y1 ? y1 : y0) + 1);
+#endif
+	c = (ca | cb) ? CLIP_PART : CLIP_IN;
+	dx = abs(x1 - x0);
+	sx = x0 < x1 ? 1 : -1;
+	dy = abs(y1 - y0);
+	sy = y0 < y1 ? 1 : -1;
+	err = (dx > dy ? dx : -dy) / 2;
+	for(;;)
+	{
+		sr_clip_plot(c, x0, y0);
+		if(x0 == x1 && y0 == y1)
+		{
+			break;
+		}
+
+		e2 = err;
+		if(e2 > -dx)
+		{
+			err -= dy;
+			x0 += sx;
+		}
+
+		if(e2 < dy)
+		{
+			err += dx;
+			y0 += sy;
+		}
+	}
+
+	sr_flush();
+}
+
+/* s in a font made by tools/fontc, clipped once for the whole string
+   and written row by row */
+uint16_t video_text(const video_font_t *f, uint8_t x, uint8_t y,
+	const char *s)
+{
+	video_font_t h;
+	const char *t;
+	const uint8_t *v;
+	uint8_t r, i, g, w, c;
+	int16_t x0 = x, y0 = y, x1, y1, cx;
+	uint16_t tw = video_text_width(f, s);
+	memcpy_P(&h, f, sizeof(h));
+	x1 = x0 + tw;
+	y1 = y0 + h.height;
+	if(!(c = video_clip(&x0, &y0, &x1, &y1)))
+	{
+		return tw;
+	}
+
+	y0 = y + draw_oy;
+	for(r = 0; r < h.height; ++r)
+	{
+		for(t = s, cx = x + draw_ox; *t; ++t)
+		{
+			if((g = video_font_glyph(&h, *t)) == 0xFF)
+			{
+				continue;
+			}
+
+			w = pgm_read_byte(h.width + g);
+			v = h.bitmap + pgm_read_word(h.offset + g) + r * ((w + 7) >> 3);
+			for(i = 0; i < w; ++i)
+			{
+				if(pgm_read_byte(v + (i >> 3)) & (0x80 >> (i & 7)))
+				{
+					sr_clip_plot(c, cx + i, y0 + r);
+				}
+			}
+
+			cx += w;
+		}
+	}
+
+	sr_flush();
+	return tw;
+}
+
+/* 7 pixels per byte, rows of x1 - x0 pixels */
+void video_bitmap
+(uint8_t *img, uint8_t x0, uint8_t y0, uint8_t x1, uint16_t len)
+{
+	uint8_t *end, mask, c;
+	int16_t ax, ay, sx, ex, bx0 = x0, by0 = y0, bx1 = x1, by1;
+	uint32_t n;
+	if(x1 <= x0)
+	{
+		return;
+	}
+
+	n = ((uint32_t)len * 7 + (x1 - x0) - 1) / (x1 - x0);
+	by1 = y0 + (n < 0x4000 ? n : 0x4000);
+	if(!(c = video_clip(&bx0, &by0, &bx1, &by1)))
+	{
+		return;
+	}
+
+	sx = ax = x0 + draw_ox;
+	ex = x1 + draw_ox;
+	ay = y0 + draw_oy;
+	for(end = img + len; img < end; ++img)
+	{
+		for(mask = 1; mask < 0x80; mask <<= 1)
+		{
+			if(*img & mask)
+			{
+				sr_clip_plot(c, ax, ay);
+			}
+
+			if(++ax == ex)
+			{
+				ax = sx;
+				++ay;
+			}
+		}
+	}
+
+	sr_flush();
+}
+
+#endif /* ENABLE_SPIRAM */